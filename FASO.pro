@@ -4,33 +4,28 @@
 #
 #-------------------------------------------------
 
-QT       += core gui widgets
+QT       += core gui widgets concurrent
 
 
 TARGET = FASO
 CONFIG   += console
 CONFIG   -= app_bundle
+CONFIG   += c++17
 
 TEMPLATE = app
 
+include(core.pri)
 
 SOURCES += main.cpp \
     clustercanvas.cpp \
-    agentcluster.cpp \
-    gui/qgraphicsellipseitemobject.cpp \
-    gui/qgraphicslineitemobject.cpp \
-    faso.cpp
+    gui/pointlayer.cpp
 
 FORMS += \
     clustercanvas.ui
 
 HEADERS += \
     clustercanvas.h \
-    def.h \
-    agentcluster.h \
-    gui/qgraphicsellipseitemobject.h \
-    gui/qgraphicslineitemobject.h \
-    faso.h
+    gui/pointlayer.h
 
 RESOURCES += \
     gfx.qrc
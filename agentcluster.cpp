@@ -1,22 +1,21 @@
 #include "agentcluster.h"
+#include "parallel.h"
 
 #include <iostream>
-#include <fstream>
 #include <QMutex>
+#include <QElapsedTimer>
 
 #include <math.h>
 
 AgentCluster::AgentCluster(int iterations, int swarmSize, QObject *parent)
-    : QObject(parent)
+    : Clusterer(parent)
 {
     m_iterations = iterations;
     m_agentSensorRange = 0;
     m_agentStepSize = 0;
-    m_dataMinX = 0;
-    m_dataMaxX = 0;
-    m_dataMinY = 0;
-    m_dataMaxY = 0;
     m_minRange = 0;
+    m_exactDistance = false;
+    m_distanceError = AVG_DIST_SAMPLE_ERROR;
 
     if (swarmSize <= 0)
         m_swarmSize = -1;
@@ -29,493 +28,870 @@ AgentCluster::~AgentCluster() {
 }
 
 /**
- * @brief AgentCluster::loadData Attempts to load the 2-column data from the filename given.
- * @param dataSource The filename of the file to load data from.
- * @return True for successful loading, false if there was an error.
+ * @brief AgentCluster::clusterData Runs the AgentCluster algorithm.
+ * @details Picks the version of the algorithm specialized for the dimension of the data (see
+ * dimensions.h), or the generic one if there isn't one, and runs it.
  */
-bool AgentCluster::loadData(std::string dataSource) {
-    std::ifstream file(dataSource.c_str());
-    if (!file.is_open()) {
-        printf("Error: unable to open file: %s\n\n", dataSource.c_str());
-        return false;
+void AgentCluster::clusterData() {
+    switch (m_data.dimension()) {
+#define RUN_DIMENSION(D) case D: run<D>(); break;
+    SPECIALIZED_DIMENSIONS(RUN_DIMENSION)
+#undef RUN_DIMENSION
+    default:
+        run<0>();
+        break;
     }
+}
 
-    std::vector<std::string> lineString;
-
-    while (file.good()) {
-        std::string line;
-        std::getline(file, line, '\n');
-
-        lineString = split(line, ',');
-        if (lineString.size() != 2)
-            continue;
-
-        std::string xStr = lineString[0];
-        std::string yStr = lineString[1];
-
-
-        ClusterItem* item = new ClusterItem();
-        item->x = atof(xStr.c_str());
-        item->y = atof(yStr.c_str());
-        m_data.push_back(item);
+/**
+ * @brief AgentCluster::run Runs the AgentCluster algorithm on D-dimensional data.
+ * @details It initializes the agent population, and then simply calls the functions built for each
+ * of the three main clustering phases.
+ */
+template <int D>
+void AgentCluster::run() {
+    const int dimension = m_data.dimension();
+    printf("Clustering %i-dimensional data (%s)...\n", dimension,
+           isSpecializedDimension(dimension) ? "specialized" : "generic");
 
-        lineString.clear();
-    }
+    setupPhase<D>();
 
-    return true;
+    //Start each of the three clustering phases, in order
+    convergencePhase<D>();
+    consolidationPhase<D>();
+    assignmentPhase<D>();
 }
 
 /**
- * @brief AgentCluster::start Runs the AgentCluster algorithm.
- * @details It initializes the agent population, and then simply calls the functions built for each
- * of the three main clustering phases.
+ * @brief AgentCluster::setupPhase Places the swarm at random within the bounding box of the data,
+ * derives the ranges from the average point distance and indexes the data.
  */
-void AgentCluster::start() {
+template <int D>
+void AgentCluster::setupPhase() {
+    ScopedTimer timer(m_metrics, Metrics::Setup);
+    const int dimension = m_data.dimension();
 
     //Init the population to random positions;
-    m_dataMinX = m_data[0]->x;
-    m_dataMinY = m_data[0]->y;
-    m_dataMaxX = m_dataMinX;
-    m_dataMaxY = m_dataMinY;
-    for (unsigned int i = 1; i < m_data.size(); i++) {
-        ClusterItem* item = m_data[i];
-        if (item->x > m_dataMaxX)
-            m_dataMaxX = item->x;
-        else if (item->x < m_dataMinX)
-            m_dataMinX = item->x;
-
-        if (item->y > m_dataMaxY)
-            m_dataMaxY = item->y;
-        else if (item->y < m_dataMinY)
-            m_dataMinY = item->y;
+    m_dataMin.resize(dimension);
+    m_dataMax.resize(dimension);
+    for (int d = 0; d < dimension; d++) {
+        const double* column = m_data.columns[d];
+        m_dataMin[d] = column[0];
+        m_dataMax[d] = column[0];
+        for (int i = 1; i < m_data.size(); i++) {
+            double value = column[i];
+            if (value > m_dataMax[d])
+                m_dataMax[d] = value;
+            else if (value < m_dataMin[d])
+                m_dataMin[d] = value;
+        }
     }
 
     if (m_swarmSize == -1) {
         m_swarmSize = (int)((double)m_data.size() * SWARM_SIZE_FACTOR);
     }
+    m_agents.setDimension(dimension);
+    m_agents.resize(0);     //nothing carries over from a previous run
+    m_agents.resize(m_swarmSize);
     for (int i = 0; i < m_swarmSize; i++) {
-        Agent* agent = new Agent();
-        agent->x = randomDouble(m_dataMinX, m_dataMaxX);
-        agent->y = randomDouble(m_dataMinY, m_dataMaxY);
-        m_agents.push_back(agent);
+        RandomStream random(m_seed, 0, i, RandomPlacement);
+        for (int d = 0; d < dimension; d++)
+            m_agents.column(d)[i] = random.uniform(m_dataMin[d], m_dataMax[d]);
     }
     printf("Created a swarm containing %i agents...\n", m_swarmSize);
 
-    m_agentSensorRange = averageClusterDistance() * SENSOR_TO_AVG_DIST_RATIO;
+    m_agentSensorRange = averageClusterDistance<D>() * SENSOR_TO_AVG_DIST_RATIO;
     m_minRange = m_agentSensorRange * 0.2;
 
     m_agentStepSize = m_agentSensorRange * STEP_SIZE_TO_SENSOR_RATIO;
     m_dataConcentrationSlope = -(m_agentSensorRange - m_minRange);
     m_crowdingConcetrationSlope = (double)(-1) / m_agents.size();
 
-    for (unsigned int i = 0; i < m_agents.size(); i++)
-        m_agents[i]->foragingRange = m_agentSensorRange / 2.0;
-
+    for (int i = 0; i < m_agents.size(); i++)
+        m_agents.foragingRange[i] = m_agentSensorRange / 2.0;
 
-
-    //Start each of the three clustering phases, in order
-    convergencePhase();
-    consolidationPhase();
-    assignmentPhase();
-
-    emit finished();
+    m_dataTree.build(m_data.columnData(), dimension, m_data.size());
 }
 
 /**
  * @brief AgentCluster::convergencePhase Runs the convergence phase of the AgentSwarm algorithm
- * for a number of times determined by the iteration paramter.
+ * for at most the number of iterations given by the iteration paramter, stopping early once the
+ * number of clusters has stopped changing (see ConvergenceMonitor).
+ * @details Each agent moves with its own RandomStream, keyed by the seed, the iteration and the
+ * agent, so a given seed always replays the same run. In parallel mode the moves are synchronous
+ * (see moveSynchronously()), which makes the result independent of the number of threads.
+ *
+ * With early stopping on, the clusters are counted at the start of every CONVERGENCE_CHECK_INTERVAL
+ * iterations, once the agent grid has caught up with the previous iteration's moves. The run stops
+ * there, before anything changes, so the remaining phases see exactly the swarm that was counted.
  */
+template <int D>
 void AgentCluster::convergencePhase() {
+    ScopedTimer timer(m_metrics, Metrics::Convergence);
+    m_convergence.reset();
+    m_iterationsRun = 0;
     for (int i = 0; i < m_iterations; i++) {
-        updateHappiness();
-        updateRanges();
-        for (unsigned int j = 0; j < m_agents.size(); j++) {
-            Agent* agent= m_agents[j];
-            move(agent);
+        QElapsedTimer iterationTimer;
+        if (m_metrics.isEnabled())
+            iterationTimer.start();
+
+        rebuildAgentGrid();
+        if (i > 0 && i % CONVERGENCE_CHECK_INTERVAL == 0 && m_convergence.isEnabled()) {
+            int clusters = countClusters<D>();
+            if (!m_headless)
+                printf("\t...%i clusters after iteration %i\n", clusters, i - 1);
+            if (m_convergence.observe(clusters, i - 1))
+                break;
+        }
+        {
+            ScopedTimer updateTimer(m_metrics, Metrics::Update);
+            updateAgents<D>();
         }
 
-        printf("Finished iteration %i...\n", i);
-        if (i % UPDATE_RATE == 0) {
-            emit update(&m_data, &m_agents);
-            printf("\t...updated display\n");
-            sleep(MOVEMENT_DELAY);
+        {
+            ScopedTimer movesTimer(m_metrics, Metrics::Moves);
+            if (m_parallel)
+                moveSynchronously<D>(i);
+            else
+                moveSequentially<D>(i);
         }
+        m_iterationsRun = i + 1;
+        if (m_metrics.isEnabled())
+            m_metrics.addIteration(iterationTimer.nsecsElapsed());
+
+        if (!m_headless) {
+            printf("Finished iteration %i...\n", i);
+            if (i % UPDATE_RATE == 0) {
+                if (m_snapshots.publish(m_agents, i)) {
+                    emit snapshotReady();
+                    printf("\t...published snapshot\n");
+                }
+                sleep(MOVEMENT_DELAY);
+            }
+        }
+    }
+
+    if (m_convergence.converged())
+        printf("Converged at iteration %i\n", m_convergence.convergedAt());
+    else
+        printf("Did not converge within %i iterations\n", m_iterations);
+}
+
+/**
+ * @brief AgentCluster::moveSequentially Moves the agents one after another, in place, so every agent
+ * already sees the moves of the agents before it.
+ * @param iteration Current iteration, which keys the agents' random streams.
+ */
+template <int D>
+void AgentCluster::moveSequentially(int iteration) {
+    double position[PointCapacity<D>::value];
+    for (int i = 0; i < m_agents.size(); i++) {
+        RandomStream random(m_seed, iteration, i);
+        double happiness = move<D>(i, random, position);
+        setPosition<D>(i, position);
+        m_agents.happiness[i] = happiness;
     }
 }
 
+/**
+ * @brief AgentCluster::moveSynchronously Moves all agents at once, spread over the thread pool.
+ * @details Every agent decides its move from the positions and happiness of the previous iteration
+ * (which the agent grid still indexes), and writes the outcome into the next buffers. Once every
+ * agent is done, the buffers are swapped in. No agent sees another's move from the same iteration,
+ * so the order the agents are processed in, and the number of threads, doesn't matter.
+ * @param iteration Current iteration, which keys the agents' random streams.
+ */
+template <int D>
+void AgentCluster::moveSynchronously(int iteration) {
+    const int count = m_agents.size();
+    const int dimension = dimensionCount<D>(m_agents.dimension());
+    m_nextPosition.resize(dimension);
+    for (int d = 0; d < dimension; d++)
+        m_nextPosition[d].resize(count);
+    m_nextHappiness.resize(count);
+
+    parallelFor(count, AGENT_CHUNK_SIZE, [&](int begin, int end) {
+        double position[PointCapacity<D>::value];
+        for (int i = begin; i < end; i++) {
+            RandomStream random(m_seed, iteration, i);
+            m_nextHappiness[i] = move<D>(i, random, position);
+            for (int d = 0; d < dimension; d++)
+                m_nextPosition[d][i] = position[d];
+        }
+    });
+
+    //The grid still points at the old buffers; it is rebuilt before anything queries it again.
+    for (int d = 0; d < dimension; d++)
+        m_agents.column(d).swap(m_nextPosition[d]);
+    m_agents.happiness.swap(m_nextHappiness);
+}
+
 /**
  * @brief AgentCluster::consolidationPhase Runs the consolidation phase of the AgentSwarm algorithm.
+ * @details Drops every agent without any data within its foraging range. The agents are tested
+ * independently (on the thread pool in parallel mode), each test stopping at the first point it
+ * finds, and the survivors are then compacted in one stable pass.
  */
+template <int D>
 void AgentCluster::consolidationPhase() {
-    for (std::vector<Agent*>::iterator i = m_agents.begin(); i != m_agents.end(); i++) {
-        Agent* agent = (*i);
-        if (dataWithinForagingRange(agent).size() < 1) {
-            m_agents.erase(i);
-            delete agent;
-        }
-    }
+    ScopedTimer timer(m_metrics, Metrics::Consolidation);
+    std::vector<char> keep(m_agents.size());
+    forEachAgent([this, &keep](int i) {
+        keep[i] = hasDataWithinForagingRange<D>(i);
+    });
+    m_agents.compact(keep);
 }
 
 
 /**
  * @brief AgentCluster::assignmentPhase Runs the assignment phase of the AgentSwarm algorithm.
+ * @details Agents within twice the foraging range of one another (either one's) belong to the same
+ * cluster. The connected components of that graph come from linkAgents(). Every component becomes a
+ * cluster, numbered in order of its lowest agent index.
  */
+template <int D>
 void AgentCluster::assignmentPhase() {
-    for (unsigned int i = 0; i < m_agents.size(); i++) {
-        Agent* agent = m_agents[i];
-        if (agent->visited)
-            continue;
-
-        agent->visited = true;
-        Cluster* cluster = new Cluster();
-        cluster->id = m_clusters.size();
-        m_clusters.push_back(cluster);
-        std::vector<Agent*> neighbors = agentsWithinRange(agent, agent->foragingRange * 2.0);
-        addToCluster(cluster, agent, neighbors);
+    ScopedTimer timer(m_metrics, Metrics::Assignment);
+    rebuildAgentGrid();     //consolidation removed agents
+    linkAgents<D>();
+
+    std::vector<int> componentCluster(m_agents.size(), -1);
+    for (int i = 0; i < m_agents.size(); i++) {
+        int root = m_agentLinks.find(i);    //the lowest agent of its component, so seen first
+        if (componentCluster[root] == -1) {
+            componentCluster[root] = createCluster()->id;
+        }
+        Cluster* cluster = m_clusters[componentCluster[root]];
+        cluster->agents.push_back(i);
+        m_agents.cluster[i] = cluster->id;
+        m_agents.visited[i] = true;
     }
 
     for (unsigned int i = 0; i < m_clusters.size(); i++) {
         Cluster* cluster = m_clusters[i];
         for (unsigned int j = 0; j < cluster->agents.size(); j++) {
-            Agent* agent = cluster->agents[j];
-            std::vector<ClusterItem*> items = dataWithinForagingRange(agent);
+            std::vector<int> items = dataWithinForagingRange<D>(cluster->agents[j]);
             for (unsigned int k = 0; k < items.size(); k++) {
-                ClusterItem* item = items[k];
-                if (item->group != -1)
+                int item = items[k];
+                if (m_data.group[item] != -1)
                     continue;
-                item->group = cluster->id;
+                m_data.group[item] = cluster->id;
                 cluster->points.push_back(item);
             }
         }
     }
 
-    for (unsigned int i = 0; i < m_data.size(); i++) {   //assign unassigned points to the closest groups
-        ClusterItem* item = m_data[i];
-        if (item->group != -1)
-            continue;
-        Agent* closestAgent = 0;
-        double closestDistance = -1;
-        for (unsigned int j = 0; j < m_agents.size(); j++) {
-            Agent* current = m_agents[j];
-            double dist = pointDistance(current->x, item->x, current->y, item->y);
-            if (dist < closestDistance || closestDistance == -1) {
-                closestAgent = current;
-                closestDistance = dist;
-            }
-        }
-        item->group = closestAgent->cluster;
-        for (unsigned int j = 0; j < m_clusters.size(); j++) {
-            Cluster* cluster = m_clusters[j];
-            if (cluster->id == item->group)
-                cluster->points.push_back(item);
+    assignUnclaimedPoints<D>();
+}
+
+/**
+ * @brief AgentCluster::assignUnclaimedPoints Gives every point no agent has in range to the cluster
+ * of the closest agent.
+ * @details The closest agents are looked up in a k-d tree over the agents, on the thread pool in
+ * chunks of points; each point only writes its own group. The points are then added to their
+ * clusters in index order, so the result doesn't depend on the number of threads. Cluster ids are
+ * their index in m_clusters.
+ */
+template <int D>
+void AgentCluster::assignUnclaimedPoints() {
+    if (m_agents.size() == 0)
+        return;
+
+    const double* columns[MAX_DIMENSIONS];
+    for (int d = 0; d < m_agents.dimension(); d++)
+        columns[d] = m_agents.column(d).data();
+    m_agentTree.build(columns, m_agents.dimension(), m_agents.size());
+
+    std::vector<char> unclaimed(m_data.size());
+    for (int i = 0; i < m_data.size(); i++)
+        unclaimed[i] = (m_data.group[i] == -1);
+
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    parallelFor(m_data.size(), POINT_CHUNK_SIZE, [&](int begin, int end) {
+        double point[PointCapacity<D>::value];
+        int lookups = 0;
+        for (int i = begin; i < end; i++) {
+            if (!unclaimed[i])
+                continue;
+            for (int d = 0; d < dimension; d++)
+                point[d] = m_data.columns[d][i];
+            m_data.group[i] = m_agents.cluster[m_agentTree.nearest<D>(point)];
+            lookups++;
         }
+        m_metrics.count(Metrics::NeighborQueries, lookups);
+        m_metrics.count(Metrics::PointsFound, lookups);
+    });
+
+    for (int i = 0; i < m_data.size(); i++) {
+        if (unclaimed[i])
+            m_clusters[m_data.group[i]]->points.push_back(i);
     }
-    emit setClusters(&m_clusters);
 }
 
 /**
- * @brief AgentCluster::addToCluster Expands a cluster from an agent with the given neighborhood.
- * @param cluster  Cluster to add to.
- * @param agent Starting agent.
- * @param neighbors Neighbors of the starting agent.
+ * @brief AgentCluster::linkAgents Merges every agent with the agents within twice its foraging
+ * range in m_agentLinks, leaving one set per connected component.
+ * @details Each agent only looks up its own neighbors through the agent grid, and the union-find is
+ * lock-free, so the agents are spread over the thread pool in parallel mode. The resulting sets
+ * don't depend on the order of the merges.
+ * @param members One flag per agent for the agents to link, or 0 for all of them. The others are
+ * left in sets of their own.
  */
-void AgentCluster::addToCluster(Cluster* cluster, Agent* agent, std::vector<Agent*> neighbors) const {
-    cluster->agents.push_back(agent);
-    agent->cluster = cluster->id;
-    for (unsigned int i = 0; i < neighbors.size(); i++) {
-        Agent* neighbor = neighbors[i];
-        if (neighbor->visited)
-            continue;
-        neighbor->visited = true;
-        std::vector<Agent*> nextNeighbors = agentsWithinRange(neighbor, neighbor->foragingRange * 2.0);
-        for (unsigned int j = 0; j < nextNeighbors.size(); j++)
-            neighbors.push_back(nextNeighbors[j]);
-        cluster->agents.push_back(neighbor);
-        neighbor->cluster = cluster->id;
+template <int D>
+void AgentCluster::linkAgents(const char *members) {
+    m_agentLinks.reset(m_agents.size());
+    forEachAgent([this, members](int i) {
+        if (members && !members[i])
+            return;
+        double position[PointCapacity<D>::value];
+        agentPosition<D>(i, position);
+        int linked = 0;
+        m_agentGrid.visit<D>(position, m_agents.foragingRange[i] * 2.0, i,
+                             [this, i, members, &linked](int other, double) {
+            if (members && !members[other])
+                return;
+            m_agentLinks.unite(i, other);
+            linked++;
+        });
+        m_metrics.count(Metrics::NeighborQueries);
+        m_metrics.count(Metrics::PointsFound, linked);
+    });
+}
+
+/**
+ * @brief AgentCluster::countClusters Counts the clusters the run would end with if it stopped now,
+ * without changing the swarm: the agents consolidation would keep, linked as the assignment phase
+ * links them.
+ * @details Needs the agent grid to be up to date with the current positions.
+ */
+template <int D>
+int AgentCluster::countClusters() {
+    m_withData.resize(m_agents.size());
+    forEachAgent([this](int i) {
+        m_withData[i] = hasDataWithinForagingRange<D>(i);
+    });
+    linkAgents<D>(m_withData.data());
+
+    int clusters = 0;
+    for (int i = 0; i < m_agents.size(); i++) {
+        if (m_withData[i] && m_agentLinks.find(i) == i)
+            clusters++;
     }
+    return clusters;
 }
 
 /**
- * @brief AgentCluster::updateRanges Update the effective and selection ranges of all agents.
+ * @brief AgentCluster::updateAgents Update the happiness of all agents, as based on their current
+ * position, and then their effective and selection ranges.
  * @details We follow a basic formula for the effective and selection ranges of agents as described
  * in the original AgentCluster paper. That is, the foraging range r_f is:
  *      r_f = alpha + (r_s - alpha)/(1 + beta * neighborCount)
+ * Both use the data count within the old foraging range, and an agent's happiness only depends on
+ * its own ranges, so one neighborhood evaluation per agent serves both.
  */
-void AgentCluster::updateRanges() {
-    for (unsigned int i = 0; i < m_agents.size(); i++) {
-        Agent *agent = m_agents[i];
-
-
-        int dataCount = (int) dataWithinForagingRange(agent).size();
-
-        double r_f = m_minRange + ((m_agentSensorRange - m_minRange) / (1.0 + AGENT_BETA * (double)dataCount));
-
-        agent->foragingRange = (r_f + agent->foragingRange) * 0.5;
-        agent->crowdingRange = agent->foragingRange * CROWDING_TO_FORAGE_DIST_RATIO;
-    }
+template <int D>
+void AgentCluster::updateAgents() {
+    forEachAgent([this](int i) {
+        double position[PointCapacity<D>::value];
+        agentPosition<D>(i, position);
+        Neighborhood<D> neighborhood;
+        evaluateNeighborhood<D>(i, position, DataCount | Crowding, neighborhood);
+        m_agents.happiness[i] = calculateHappiness<D>(i, neighborhood);
+
+        double r_f = m_minRange + ((m_agentSensorRange - m_minRange) / (1.0 + AGENT_BETA * (double)neighborhood.dataCount));
+
+        m_agents.foragingRange[i] = (r_f + m_agents.foragingRange[i]) * 0.5;
+        m_agents.crowdingRange[i] = m_agents.foragingRange[i] * CROWDING_TO_FORAGE_DIST_RATIO;
+    });
 }
 
 /**
- * @brief AgentCluster::updateHappiness Update the hapiness of all agents, as based on their current
- * position.
+ * @brief AgentCluster::forEachAgent Calls body(agent) for every agent. Runs on the thread pool in
+ * parallel mode, so body may only write to the agent it was given.
  */
-void AgentCluster::updateHappiness() {
-    for (unsigned int i = 0; i < m_agents.size(); i++) {
-        Agent* agent = m_agents[i];
-        agent->happiness = calculateHappiness(agent);
+template <typename Function>
+void AgentCluster::forEachAgent(Function body) {
+    if (!m_parallel) {
+        for (int i = 0; i < m_agents.size(); i++)
+            body(i);
+        return;
     }
+    parallelFor(m_agents.size(), AGENT_CHUNK_SIZE, [&body](int begin, int end) {
+        for (int i = begin; i < end; i++)
+            body(i);
+    });
 }
 
 /**
- * @brief AgentCluster::move Takes care of moving an Agent to its next location.
- * @param agent Agent to move.
+ * @brief AgentCluster::move Works out where an Agent moves to next. Doesn't change anything, so it can
+ * run for many agents at once.
+ * @param agent Index of the Agent to move.
+ * @param random The Agent's random stream for this iteration.
+ * @param position Receives the Agent's new position.
+ * @return The Agent's happiness at its new position.
  */
-void AgentCluster::move(Agent *agent) {
-    std::vector<Agent*> neighbors =  agentsWithinForagingRange(agent);    //bestAgentInRange(agent);   //best agent in range.
-    if (neighbors.size() != 0) {    //has neighbors
-        Agent* bestNeighbor = neighbors[0];
-        for (unsigned int i = 1; i < neighbors.size(); i++) {
-            Agent* candidate = neighbors[i];
-            if (candidate->happiness > bestNeighbor->happiness)
-                bestNeighbor = candidate;
-        }
-        if (bestNeighbor->happiness > agent->happiness) {   //found a better neighbor we should move towards
-            moveTowards(agent, bestNeighbor);
+template <int D>
+double AgentCluster::move(int agent, RandomStream &random, double *position) const {
+    double current[PointCapacity<D>::value];
+    agentPosition<D>(agent, current);
+    Neighborhood<D> neighborhood;
+    evaluateNeighborhood<D>(agent, current, BestNeighbor, neighborhood);
+    int bestNeighbor = neighborhood.bestNeighbor;
+    if (bestNeighbor >= 0) {    //has neighbors
+        if (m_agents.happiness[bestNeighbor] > m_agents.happiness[agent]) {   //found a better neighbor we should move towards
+            return moveTowards<D>(agent, bestNeighbor, random, position);
         } else {    //otherwise, just move randomly :(
-            moveRandomly(agent);
+            return moveRandomly<D>(agent, random, position);
         }
-    } else {    //all alone...
-        std::vector<ClusterItem*> items = dataWithinForagingRange(agent);
-
-        if (items.size() != 0) {    //alone, but with data?
-            //Find the average position vector and move in that direction
-            double avgX = 0;
-            double avgY = 0;
-            for (unsigned int i = 0; i < items.size(); i++) {
-                ClusterItem* item = items[i];
-                avgX += item->x - agent->x;
-                avgY += item->y - agent->y;
-            }
-            avgX /= (double)items.size();
-            avgY /= (double)items.size();
-            double magnitude = randomDouble(0.1, 1);
-
-            agent->x += avgX * magnitude;
-            agent->y += avgY * magnitude;
-        } else {                    //alone AND no data?
-            moveRandomly(agent);
+    }
+
+    //all alone...
+    evaluateNeighborhood<D>(agent, current, DataCentroid, neighborhood);
+    if (neighborhood.dataCount != 0) {  //alone, but with data?
+        //Move towards the centroid of the data in range
+        const int dimension = dimensionCount<D>(m_data.dimension());
+        double magnitude = random.uniform(0.1, 1);
+        for (int d = 0; d < dimension; d++) {
+            double centroid = neighborhood.dataSum[d] / (double)neighborhood.dataCount;
+            position[d] = current[d] + (centroid - current[d]) * magnitude;
         }
+        return m_agents.happiness[agent];
+    } else {                            //alone AND no data?
+        return moveRandomly<D>(agent, random, position);
     }
 }
 
 /**
  * @brief AgentCluster::moveTowards Moves the first agent towards the second one.
- * @param agentOne The agent being moved.
- * @param agentTwo The agent who is being moved towards.
+ * @param agentOne Index of the agent being moved.
+ * @param agentTwo Index of the agent who is being moved towards.
+ * @param random The moving agent's random stream.
+ * @param position Receives the first agent's new position.
+ * @return The first agent's happiness at its new position.
  */
-void AgentCluster::moveTowards(Agent *agentOne, Agent *agentTwo) {
-    double crowdingFactor = (agentOne->crowdingRange + agentTwo->crowdingRange) * 0.5;
-    double agentDistance = pointDistance(agentOne->x, agentTwo->x, agentOne->y, agentTwo->y) - crowdingFactor;
-
-    if (agentDistance == 0)
-        return;
-
-    double moveMagnitude = std::min(randomDouble(0, agentOne->foragingRange), agentDistance) * randomDouble(0, 0.9);
-    double unitVectorX = (agentTwo->x - agentOne->x) / agentDistance;
-    double unitVectorY = (agentTwo->y - agentOne->y) / agentDistance;
+template <int D>
+double AgentCluster::moveTowards(int agentOne, int agentTwo, RandomStream &random, double *position) const {
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    double one[PointCapacity<D>::value];
+    double two[PointCapacity<D>::value];
+    agentPosition<D>(agentOne, one);
+    agentPosition<D>(agentTwo, two);
+
+    double crowdingFactor = (m_agents.crowdingRange[agentOne] + m_agents.crowdingRange[agentTwo]) * 0.5;
+    double agentDistance = sqrt(pointDistanceSquared<D>(one, two, dimension)) - crowdingFactor;
+
+    if (agentDistance == 0) {
+        for (int d = 0; d < dimension; d++)
+            position[d] = one[d];
+        return m_agents.happiness[agentOne];
+    }
 
-    double newX = agentOne->x + (moveMagnitude * unitVectorX);
-    double newY = agentOne->y + (moveMagnitude * unitVectorY);
+    double moveMagnitude = std::min(random.uniform(0, m_agents.foragingRange[agentOne]), agentDistance) * random.uniform(0, 0.9);
+    for (int d = 0; d < dimension; d++) {
+        double unitVector = (two[d] - one[d]) / agentDistance;
+        position[d] = one[d] + (moveMagnitude * unitVector);
+        Q_ASSERT_X(nanTest(position[d]), "Failed NaN", __FUNCTION__);
+    }
+    clampToData<D>(position);
 
-    Q_ASSERT_X(nanTest(newX), "Failed NaN", __FUNCTION__);
-    Q_ASSERT_X(nanTest(newY), "Failed NaN", __FUNCTION__);
+    return happinessAt<D>(agentOne, position);
+}
 
-    if (newX > m_dataMaxX)
-        newX = m_dataMaxX;
-    else if (newX < m_dataMinX)
-        newX = m_dataMinX;
-    if (newY > m_dataMaxY)
-        newY = m_dataMaxY;
-    else if (newY < m_dataMinY)
-        newY = m_dataMinY;
+/**
+ * @brief AgentCluster::moveRandomly Moves the agent randomly across the search space, a distance
+ * related to the Agent's foraging range. If the newly selected position has a lower hapiness
+ * level than the original, the agent stays at the original spot.
+ * @param agent Index of the Agent to move.
+ * @param random The Agent's random stream.
+ * @param position Receives the Agent's new position.
+ * @return The Agent's happiness at its new position.
+ */
+template <int D>
+double AgentCluster::moveRandomly(int agent, RandomStream &random, double *position) const {
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    double initial[PointCapacity<D>::value];
+    agentPosition<D>(agent, initial);
+    double initialHappiness = m_agents.happiness[agent];
+
+    double moveMagnitude =  random.uniform(0.0, m_agents.foragingRange[agent] * RANDOM_MOVE_FACTOR + 1);
+    double direction[PointCapacity<D>::value];
+    randomDirection<D>(random, direction);
+
+    for (int d = 0; d < dimension; d++) {
+        position[d] = initial[d] + (direction[d] * moveMagnitude);
+        Q_ASSERT_X(nanTest(position[d]), "Failed NaN", __FUNCTION__);
+    }
+    clampToData<D>(position);
 
+    double newHappiness = happinessAt<D>(agent, position);
+    if (newHappiness >= initialHappiness) //did we find a better position?
+        return newHappiness;
 
-    agentOne->x = newX;
-    agentOne->y = newY;
-    agentOne->happiness = calculateHappiness(agentOne);
+    //otherwise, stay put...
+    for (int d = 0; d < dimension; d++)
+        position[d] = initial[d];
+    return initialHappiness;
 }
 
 /**
- * @brief AgentCluster::moveRandomly Moves the agent randomly across the search space, a distance
- * related to the Agent's foraging range. If the newly selected position has a lower hapiness
- * level than the original, the agent is moved back to the original spot.
- * @param agent Agent to move.
+ * @brief AgentCluster::randomDirection Picks a uniformly random unit vector.
+ * @details In 2d this is a random angle. In more dimensions, a vector of normally distributed
+ * components points in a uniformly random direction once normalized.
+ * @param random Stream to draw from.
+ * @param direction Receives the unit vector.
  */
-void AgentCluster::moveRandomly(Agent *agent) {
-    double initialX = agent->x;
-    double initialY = agent->y;
-    double initialHappiness = agent->happiness;
-
-    double moveMagnitude =  randomDouble(0.0, agent->foragingRange * RANDOM_MOVE_FACTOR + 1);
-    double moveDirection = randomDouble(0, 360) * (PI / 180.0);
-
-    double posX = initialX + (cos(moveDirection) * moveMagnitude);
-    double posY = initialY + (sin(moveDirection) * moveMagnitude);
-
-    Q_ASSERT_X(nanTest(posX), "Failed NaN", __FUNCTION__);
-    Q_ASSERT_X(nanTest(posY), "Failed NaN", __FUNCTION__);
-
-    if (posX > m_dataMaxX)
-        posX = m_dataMaxX;
-    else if (posX < m_dataMinX)
-        posX = m_dataMinX;
-    if (posY > m_dataMaxY)
-        posY = m_dataMaxY;
-    else if (posY < m_dataMinY)
-        posY = m_dataMinY;
-
-    agent->x = posX;
-    agent->y = posY;
-    double newHappiness = calculateHappiness(agent);
-    if (newHappiness >= initialHappiness) { //did we find a better position?
-        agent->happiness = newHappiness;
+template <int D>
+void AgentCluster::randomDirection(RandomStream &random, double *direction) const {
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    if (dimension == 2) {
+        double angle = random.uniform(0, 360) * (PI / 180.0);
+        direction[0] = cos(angle);
+        direction[1] = sin(angle);
         return;
     }
 
-    //otherwise, move back...
-    agent->x = initialX;
-    agent->y = initialY;
+    double length = 0;
+    for (int d = 0; d < dimension; d++) {
+        direction[d] = random.normal();
+        length += direction[d] * direction[d];
+    }
+    length = sqrt(length);
+    for (int d = 0; d < dimension; d++)
+        direction[d] = (length > 0) ? direction[d] / length : (d == 0);
 }
 
 /**
- * @brief AgentCluster::bestAgentInRange Finds the best Agent within the foraging range, based on
- * Euclidean distance. If there are no agents within the given Agent's foraging range, 0 is
- * returned.
- * @param agent The Agent to find the closest neighbor for.
- * @return The best Agent within range, or 0 if no Agents are found.
+ * @brief AgentCluster::clampToData Moves a position back inside the bounding box of the data.
  */
-Agent* AgentCluster::bestAgentInRange(Agent *agent) const {
-    std::vector<Agent*> agents = agentsWithinForagingRange(agent);
-    double bestHappiness = 0;
-    Agent* bestAgent = 0;
-    for (unsigned int i = 0; i < agents.size(); i++) {
-        Agent* testAgent = agents[i];
-        if (testAgent->happiness > bestHappiness) {
-            bestHappiness = testAgent->happiness;
-            bestAgent = testAgent;
-        }
+template <int D>
+void AgentCluster::clampToData(double *position) const {
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    for (int d = 0; d < dimension; d++) {
+        if (position[d] > m_dataMax[d])
+            position[d] = m_dataMax[d];
+        else if (position[d] < m_dataMin[d])
+            position[d] = m_dataMin[d];
     }
-    return bestAgent;
 }
 
 /**
- * @brief AgentCluster::dataWithinForagingRange Finds data points within the give Agent's foraging
- * range.
- * @param agent The Agent to find data points for.
- * @return A vector of ClusterItem objects within the Agent's foraging range.
+ * @brief AgentCluster::agentPosition Copies an Agent's coordinates into a point.
  */
-std::vector<ClusterItem*> AgentCluster::dataWithinForagingRange(Agent *agent) const {
-    std::vector<ClusterItem*> items;
-    for (unsigned int i = 0; i < m_data.size(); i++) {
-        ClusterItem* item = m_data[i];
-        double distance = pointDistance(agent->x, item->x, agent->y, item->y);
-        if (distance <= agent->foragingRange)
-            items.push_back(item);
-    }
-    return items;
+template <int D>
+void AgentCluster::agentPosition(int agent, double *position) const {
+    const int dimension = dimensionCount<D>(m_agents.dimension());
+    for (int d = 0; d < dimension; d++)
+        position[d] = m_agents.column(d)[agent];
 }
 
 /**
- * @brief AgentCluster::agentsWithinCrowdingRange Finds Agents within the given Agent's personal
- * range.
- * @param agent The Agent to find neighbors for.
- * @return A vector of Agent objects within the Agent's crowding range.
+ * @brief AgentCluster::setPosition Moves an Agent to a new position, keeping the agent grid in sync
+ * so that neighbor queries from other agents see the move straight away.
+ * @param agent Index of the Agent to move.
+ * @param position New position.
  */
-std::vector<Agent*> AgentCluster::agentsWithinCrowdingRange(Agent *agent) const {
-    return agentsWithinRange(agent, agent->crowdingRange);
+template <int D>
+void AgentCluster::setPosition(int agent, const double *position) {
+    const int dimension = dimensionCount<D>(m_agents.dimension());
+    double oldX = m_agents.x[agent];
+    double oldY = m_agents.y[agent];
+    for (int d = 0; d < dimension; d++)
+        m_agents.column(d)[agent] = position[d];
+    m_agentGrid.relocate(agent, oldX, oldY);
 }
 
 /**
- * @brief AgentCluster::agentsWithinForagingRange Finds Agent objects within the given Agent's
- * foraging range.
- * @param agent The Agent to find neighbors for.
- * @return A vector of Agent objects within the foraging range.
+ * @brief AgentCluster::rebuildAgentGrid Re-indexes every agent from scratch. Done once per
+ * iteration; moves in between are tracked incrementally by setPosition().
  */
-std::vector<Agent*> AgentCluster::agentsWithinForagingRange(Agent *agent) const {
-    return agentsWithinRange(agent, agent->foragingRange);
+void AgentCluster::rebuildAgentGrid() {
+    const double* columns[MAX_DIMENSIONS];
+    for (int d = 0; d < m_agents.dimension(); d++)
+        columns[d] = m_agents.column(d).data();
+    m_agentGrid.build(columns, m_agents.dimension(), m_agents.size(),
+                      m_agentSensorRange, m_dataMin[0], m_dataMin[1], m_dataMax[0], m_dataMax[1]);
 }
 
 /**
- * @brief AgentCluster::agentsWithinRange Finds Agent objects within the given range of the
- * Agent.
- * @param agent Agent to search around.
- * @param range Range of search.
- * @return A vector of Agent objects within the given range.
+ * @brief AgentCluster::evaluateNeighborhood Gathers what an Agent would see at a position, with its
+ * current ranges, in one pass.
+ * @details The data statistics come from a single walk of the data tree; with DataCentroid, subtrees
+ * that lie entirely in range contribute their precomputed coordinate sums instead of their points.
+ * The agent statistics come from a single walk of the agent grid, over the larger of the ranges
+ * asked for. The best neighbor is the first of the happiest agents in the order the grid visits
+ * them, as the agent list used to be scanned.
+ * @param agent Index of the Agent to evaluate for.
+ * @param position Position to evaluate at. Other agents are taken at the positions the agent grid has
+ * them at.
+ * @param statistics NeighborhoodStatistic flags for the fields to fill in; others are left at zero,
+ * or -1 for bestNeighbor (dataSum is only touched for DataCentroid).
+ * @param neighborhood Receives the results.
  */
-std::vector<Agent*> AgentCluster::agentsWithinRange(Agent *agent, double range) const {
-    std::vector<Agent*> closeAgents;
-    for (unsigned int i = 0; i < m_agents.size(); i++) {
-        Agent* testAgent = m_agents[i];
-        if (testAgent == agent)
-            continue;
-        double distance = sqrt(pow(testAgent->x - agent->x, 2) + pow(testAgent->y - agent->y, 2));
-        if (distance <= range)
-            closeAgents.push_back(testAgent);
+template <int D>
+void AgentCluster::evaluateNeighborhood(int agent, const double *position, int statistics,
+                                        Neighborhood<D> &neighborhood) const {
+    const double foragingRange = m_agents.foragingRange[agent];
+    const double crowdingRange = m_agents.crowdingRange[agent];
+    neighborhood.dataCount = 0;
+    neighborhood.crowdingCount = 0;
+    neighborhood.bestNeighbor = -1;
+
+    if (statistics & DataCentroid) {
+        const int dimension = dimensionCount<D>(m_data.dimension());
+        for (int d = 0; d < dimension; d++)
+            neighborhood.dataSum[d] = 0;
+        neighborhood.dataCount = m_dataTree.sumWithinRadius<D>(position, foragingRange, neighborhood.dataSum);
+    } else if (statistics & DataCount) {
+        neighborhood.dataCount = m_dataTree.countWithinRadius<D>(position, foragingRange);
+    }
+    if (statistics & (DataCount | DataCentroid)) {
+        m_metrics.count(Metrics::NeighborQueries);
+        m_metrics.count(Metrics::PointsFound, neighborhood.dataCount);
     }
-    return closeAgents;
+
+    const bool countCrowding = (statistics & Crowding) != 0;
+    const bool findBest = (statistics & BestNeighbor) != 0;
+    if (!findBest) {
+        if (countCrowding) {    //a plain count is cheaper than visiting every hit
+            neighborhood.crowdingCount = m_agentGrid.count<D>(position, crowdingRange, agent);
+            m_metrics.count(Metrics::NeighborQueries);
+            m_metrics.count(Metrics::PointsFound, neighborhood.crowdingCount);
+        }
+        return;
+    }
+
+    const double range = countCrowding ? std::max(crowdingRange, foragingRange) : foragingRange;
+    const double crowdingSquared = crowdingRange * crowdingRange;
+    const double foragingSquared = foragingRange * foragingRange;
+    const double* happiness = m_agents.happiness.data();
+    int crowdingCount = 0;
+    int bestNeighbor = -1;
+    int found = 0;
+    m_agentGrid.visit<D>(position, range, agent, [&](int other, double distanceSquared) {
+        found++;
+        if (countCrowding && distanceSquared <= crowdingSquared)
+            crowdingCount++;
+        if (distanceSquared <= foragingSquared
+                && (bestNeighbor < 0 || happiness[other] > happiness[bestNeighbor]))
+            bestNeighbor = other;
+    });
+    neighborhood.crowdingCount = crowdingCount;
+    neighborhood.bestNeighbor = bestNeighbor;
+    m_metrics.count(Metrics::NeighborQueries);
+    m_metrics.count(Metrics::PointsFound, found);
 }
+
 /**
- * @brief AgentCluster::calculateHappiness Calculates the happiness of the Agent at its given
- * position, with a value between [0, 1].
+ * @brief AgentCluster::dataWithinForagingRange Finds data points within the give Agent's foraging
+ * range.
+ * @details Only needed where the points themselves are used; hasDataWithinForagingRange() and
+ * evaluateNeighborhood() are cheaper when whether there are any, or how many, is all that matters.
+ * @param agent Index of the Agent to find data points for.
+ * @return Indices of the data points within the Agent's foraging range.
+ */
+template <int D>
+std::vector<int> AgentCluster::dataWithinForagingRange(int agent) const {
+    double position[PointCapacity<D>::value];
+    agentPosition<D>(agent, position);
+    std::vector<int> items;
+    m_dataTree.query<D>(position, m_agents.foragingRange[agent], items);
+    m_metrics.count(Metrics::NeighborQueries);
+    m_metrics.count(Metrics::PointsFound, items.size());
+    return items;
+}
+
+/**
+ * @brief AgentCluster::hasDataWithinForagingRange Tests whether there are any data points within
+ * the given Agent's foraging range.
+ * @param agent Index of the Agent to test.
+ * @return True if at least one data point is within the Agent's foraging range.
+ */
+template <int D>
+bool AgentCluster::hasDataWithinForagingRange(int agent) const {
+    double position[PointCapacity<D>::value];
+    agentPosition<D>(agent, position);
+    bool found = m_dataTree.anyWithinRadius<D>(position, m_agents.foragingRange[agent]);
+    m_metrics.count(Metrics::NeighborQueries);
+    m_metrics.count(Metrics::PointsFound, found);
+    return found;
+}
+
+/**
+ * @brief AgentCluster::calculateHappiness Calculates the happiness of the Agent in a neighborhood,
+ * with a value between [0, 1].
  * @details The happiness of Agent i is related to both the number of neighboring agents, and the
  * local data point concentration.
- * @param agent The Agent to calculate happiness for.
+ * @param agent Index of the Agent to calculate happiness for.
+ * @param neighborhood The Agent's neighborhood, with at least DataCount and Crowding filled in.
  * @return Happiness value between [0, 1].
  * @warning Uses a very basic linear function system. Needs to be updated for logistic style scaling
  * and to include the crowding/data concentration weights.
  */
-double AgentCluster::calculateHappiness(Agent *agent) const {
+template <int D>
+double AgentCluster::calculateHappiness(int agent, const Neighborhood<D> &neighborhood) const {
     //h(i) = O(p_i) / (pi * r_f^2 *|A(p_i, r_c^i)| + 1)
 
     //For our clustering algorithm, the objective function is the percentage of data points located
     //within the foraging range of the agent.
-    double objectiveFunctionValue = (double)dataWithinForagingRange(agent).size() / (double)m_data.size();
+    double objectiveFunctionValue = (double)neighborhood.dataCount / (double)m_data.size();
 
-    double neighborScore = CROWDING_ADVERSION_FACTOR * (double)agentsWithinCrowdingRange(agent).size();
-    double totalScore = objectiveFunctionValue / (double)((neighborScore * PI * pow(agent->foragingRange, 2)) + 1.0);
+    double neighborScore = CROWDING_ADVERSION_FACTOR * (double)neighborhood.crowdingCount;
+    double totalScore = objectiveFunctionValue / (double)((neighborScore * PI * pow(m_agents.foragingRange[agent], 2)) + 1.0);
     //double totalScore = objectiveFunctionValue / (double)(neighborScore + 1.0);
 
     return totalScore;
 }
 
+/**
+ * @brief AgentCluster::happinessAt Calculates the happiness the Agent would have at another position,
+ * with its current ranges. Other agents are taken at the positions the agent grid has them at.
+ * @param agent Index of the Agent to calculate happiness for.
+ * @param position Position to evaluate.
+ * @return Happiness value between [0, 1].
+ */
+template <int D>
+double AgentCluster::happinessAt(int agent, const double *position) const {
+    Neighborhood<D> neighborhood;
+    evaluateNeighborhood<D>(agent, position, DataCount | Crowding, neighborhood);
+    return calculateHappiness<D>(agent, neighborhood);
+}
+
 
 /**
  * @brief AgentCluster::averageClusterDistance Calculates the average distance between all data
  * points in the supplied data.
+ * @details By default the average is estimated from randomly sampled pairs of points, which stops
+ * once the estimate is within the configured relative error (see setDistanceError()). Datasets
+ * small enough that sampling would do about as much work as the full computation, or runs with
+ * setExactDistance(true), get the exact average instead.
  * @return
  */
+template <int D>
 double AgentCluster::averageClusterDistance() const {
-    if (m_data.size() == 0)
+    if (m_data.size() < 2)
         return 1.0;
 
-    int count = 0;
-    double averageDistance = 0;
-    for (unsigned int i = 0; i < m_data.size(); i++) {
-        ClusterItem* itemOne = m_data[i];
-        for (unsigned int j = 0; j < m_data.size(); j++) {
+    double pairs = (double)m_data.size() * (double)(m_data.size() - 1) * 0.5;
+    if (m_exactDistance || pairs <= AVG_DIST_MAX_SAMPLES)
+        return exactAverageDistance<D>();
+    return sampledAverageDistance<D>();
+}
+
+/**
+ * @brief AgentCluster::exactAverageDistance Calculates the exact average distance over every pair
+ * of data points.
+ * @details Each unordered pair is only visited once (i < j). The coordinate columns are processed
+ * in square tiles that fit in cache, with one task per row of tiles on the thread pool. Every row
+ * writes its own partial sum, and the partial sums are added in row order, so the result doesn't
+ * depend on the number of threads.
+ * @return Average point-to-point distance.
+ */
+template <int D>
+double AgentCluster::exactAverageDistance() const {
+    const int count = m_data.size();
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    const double* const* columns = m_data.columnData();
+
+    const int tileCount = (count + AVG_DIST_TILE_SIZE - 1) / AVG_DIST_TILE_SIZE;
+    std::vector<double> rowSums(tileCount, 0.0);
+    parallelFor(tileCount, 1, [&](int firstTile, int lastTile) {
+        double point[PointCapacity<D>::value];
+        for (int tile = firstTile; tile < lastTile; tile++) {
+            int rowBegin = tile * AVG_DIST_TILE_SIZE;
+            int rowEnd = std::min(count, rowBegin + AVG_DIST_TILE_SIZE);
+            double rowSum = 0;
+            for (int columnBegin = rowBegin; columnBegin < count; columnBegin += AVG_DIST_TILE_SIZE) {
+                int columnEnd = std::min(count, columnBegin + AVG_DIST_TILE_SIZE);
+                for (int i = rowBegin; i < rowEnd; i++) {
+                    int j = std::max(columnBegin, i + 1);
+                    if (j >= columnEnd)
+                        continue;
+                    for (int d = 0; d < dimension; d++)
+                        point[d] = columns[d][i];
+                    rowSum += distanceSum<D>(point, columns, j, columnEnd - j, dimension);
+                }
+            }
+            rowSums[tile] = rowSum;
+        }
+    });
+
+    double total = 0;
+    for (int i = 0; i < tileCount; i++)
+        total += rowSums[i];
+    return total / ((double)count * (double)(count - 1) * 0.5);
+}
+
+/**
+ * @brief AgentCluster::sampledAverageDistance Estimates the average distance between data points
+ * from randomly chosen pairs.
+ * @details Samples are drawn in batches, and after each batch the 95% confidence interval of the
+ * running mean is compared against the requested relative error. Gives up refining after
+ * AVG_DIST_MAX_SAMPLES pairs.
+ * @return Estimated average point-to-point distance.
+ */
+template <int D>
+double AgentCluster::sampledAverageDistance() const {
+    const int count = m_data.size();
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    const double* const* columns = m_data.columnData();
+    double point[PointCapacity<D>::value];
+    RandomStream random(m_seed, 0, 0, RandomSampling);
+
+    double samples = 0;
+    double mean = 0;
+    double squaredDeviations = 0;   //running sum for the variance (Welford)
+    while (samples < AVG_DIST_MAX_SAMPLES) {
+        for (int n = 0; n < AVG_DIST_SAMPLE_BATCH; n++) {
+            int i = random.below(count);
+            int j = random.below(count);
             if (i == j)
                 continue;
-            ClusterItem* itemTwo = m_data[j];
-            averageDistance += sqrt(pow(itemTwo->x - itemOne->x, 2) + pow(itemTwo->y - itemOne->y, 2));
-            count++;
+            for (int d = 0; d < dimension; d++)
+                point[d] = columns[d][i];
+            double distance = sqrt(columnDistanceSquared<D>(point, columns, j, dimension));
+            samples++;
+            double delta = distance - mean;
+            mean += delta / samples;
+            squaredDeviations += delta * (distance - mean);
         }
+
+        if (samples < AVG_DIST_MIN_SAMPLES)
+            continue;
+        double standardError = sqrt(squaredDeviations / (samples - 1) / samples);
+        if (1.96 * standardError <= m_distanceError * mean)
+            break;
     }
 
-    if (count == 0)
-        return 1.0;
+    printf("Estimated average point distance from %.0f sampled pairs...\n", samples);
+    return mean;
+}
 
-    averageDistance /= count;
-    return averageDistance;
+/**
+ * @brief AgentCluster::distanceSum Sums the distances from one point to a contiguous run of points.
+ * @details Split over four independent accumulators so several square roots can be in flight at
+ * once, without reordering a single floating point sum.
+ * @param point The reference point.
+ * @param columns Coordinate columns of the other points.
+ * @param first Index of the first of the other points.
+ * @param count Number of other points.
+ * @param dimension Number of dimensions.
+ * @return Sum of all distances.
+ */
+template <int D>
+double AgentCluster::distanceSum(const double *point, const double * const *columns, int first, int count,
+                                 int dimension) {
+    double sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    int i = first;
+    const int end = first + count;
+    for (; i + 4 <= end; i += 4) {
+        sum0 += sqrt(columnDistanceSquared<D>(point, columns, i, dimension));
+        sum1 += sqrt(columnDistanceSquared<D>(point, columns, i + 1, dimension));
+        sum2 += sqrt(columnDistanceSquared<D>(point, columns, i + 2, dimension));
+        sum3 += sqrt(columnDistanceSquared<D>(point, columns, i + 3, dimension));
+    }
+    for (; i < end; i++)
+        sum0 += sqrt(columnDistanceSquared<D>(point, columns, i, dimension));
+    return (sum0 + sum1) + (sum2 + sum3);
 }
 
 
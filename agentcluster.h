@@ -1,12 +1,14 @@
 #ifndef AGENTCLUSTER_H
 #define AGENTCLUSTER_H
 
-#include "def.h"
-
-#include <string>
-#include <QObject>
-
-class AgentCluster : public QObject
+#include "clusterer.h"
+#include "spatialgrid.h"
+#include "kdtree.h"
+#include "unionfind.h"
+#include "snapshotring.h"
+#include "convergence.h"
+
+class AgentCluster : public Clusterer
 {
     Q_OBJECT
 
@@ -14,32 +16,35 @@ public:
     AgentCluster(int iterations, int swarmSize = -1, QObject *parent = 0);
     ~AgentCluster();
 
-    bool loadData(std::string dataSource);
+    int agentCount() const { return m_agents.size(); }
+    int convergedIteration() const { return m_convergence.convergedAt(); }
 
-    size_t dataCount() const { return m_data.size(); }
-    size_t agentCount() const { return m_agents.size(); }
+    void setExactDistance(bool exact) { m_exactDistance = exact; }
+    void setDistanceError(double relativeError) { m_distanceError = relativeError; }
+    void setConvergence(const ConvergenceCriteria& criteria) { m_convergence.setCriteria(criteria); }
 
-public slots:
-    void start();
+    SnapshotRing* snapshots() { return &m_snapshots; }
 
 signals:
-    void update(std::vector<ClusterItem*>* items, std::vector<Agent*>* agents);
-    void setClusters(std::vector<Cluster*>* clusters);
-    void finished();
+    void snapshotReady();    //take it from snapshots()
+
+protected:
+    void clusterData();
 
 private:
-    int m_iterations;
+    int m_iterations;       //upper bound; the run stops early once the swarm converges
     int m_swarmSize;
 
-    std::vector<Agent*> m_agents;
-    std::vector<ClusterItem*> m_data;
-    std::vector<Cluster*> m_clusters;
+    Swarm m_agents;
+    SnapshotRing m_snapshots;   //copies of the swarm for the canvas
 
+    KdTree m_dataTree;
+    SpatialGrid m_agentGrid;
+    UnionFind m_agentLinks;     //connected groups of agents, for the assignment phase
+    KdTree m_agentTree;         //the agents left after consolidation, for nearest-agent lookups
 
-    double m_dataMinX;
-    double m_dataMaxX;
-    double m_dataMinY;
-    double m_dataMaxY;
+    std::vector<double> m_dataMin;  //bounding box of the data, per dimension
+    std::vector<double> m_dataMax;
 
     double m_agentSensorRange;
     double m_minRange;
@@ -48,27 +53,72 @@ private:
     double m_dataConcentrationSlope;
     double m_crowdingConcetrationSlope;
 
-    void convergencePhase();
-    void consolidationPhase();
-    void assignmentPhase();
-
-    void updateRanges();
-    void updateHappiness();
-    void move(Agent* agent);
-    void moveTowards(Agent* agentOne, Agent* agentTwo);
-    void moveRandomly(Agent* agent);
-
-    Agent* bestAgentInRange(Agent* agent) const;
-
-    std::vector<ClusterItem*> dataWithinForagingRange(Agent* agent) const;
-    std::vector<Agent*> agentsWithinCrowdingRange(Agent* agent) const;
-    std::vector<Agent*> agentsWithinForagingRange(Agent* agent) const;
-    std::vector<Agent*> agentsWithinRange(Agent* agent, double range) const;
-
-    double calculateHappiness(Agent* agent) const;
-
-    void addToCluster(Cluster* cluster, Agent* agent, std::vector<Agent*> neighbors) const;
-    double averageClusterDistance() const;
+    bool m_exactDistance;
+    double m_distanceError;
+
+    std::vector<std::vector<double> > m_nextPosition;   //write buffers for synchronous (parallel) moves
+    std::vector<double> m_nextHappiness;
+    ConvergenceMonitor m_convergence;
+    std::vector<char> m_withData;   //agents that would survive consolidation, for countClusters()
+
+    /**
+     * What an agent knows about its surroundings, gathered by evaluateNeighborhood() in at most one
+     * walk of the data tree and one of the agent grid. Lives on the stack; nothing is allocated.
+     */
+    template <int D>
+    struct Neighborhood {
+        int dataCount;                              //data points within foraging range
+        double dataSum[PointCapacity<D>::value];    //their coordinates, summed per dimension
+        int crowdingCount;                          //other agents within crowding range
+        int bestNeighbor;                           //happiest other agent within foraging range, or -1
+    };
+    enum NeighborhoodStatistic {
+        DataCount = 1,
+        DataCentroid = 2,   //also counts
+        Crowding = 4,
+        BestNeighbor = 8
+    };
+
+    //Everything that touches positions is templated on the dimension D; see dimensions.h.
+    template <int D> void run();
+
+    template <int D> void setupPhase();
+    template <int D> void convergencePhase();
+    template <int D> void moveSequentially(int iteration);
+    template <int D> void moveSynchronously(int iteration);
+    template <int D> void consolidationPhase();
+    template <int D> void assignmentPhase();
+
+    template <int D> void updateAgents();
+    template <int D> double move(int agent, RandomStream& random, double* position) const;
+    template <int D> double moveTowards(int agentOne, int agentTwo, RandomStream& random, double* position) const;
+    template <int D> double moveRandomly(int agent, RandomStream& random, double* position) const;
+    template <int D> void randomDirection(RandomStream& random, double* direction) const;
+    template <int D> void clampToData(double* position) const;
+    template <int D> void agentPosition(int agent, double* position) const;
+    template <int D> void setPosition(int agent, const double* position);
+    void rebuildAgentGrid();
+
+    template <int D> void evaluateNeighborhood(int agent, const double* position, int statistics,
+                                               Neighborhood<D>& neighborhood) const;
+
+    template <int D> std::vector<int> dataWithinForagingRange(int agent) const;
+    template <int D> bool hasDataWithinForagingRange(int agent) const;
+
+    template <int D> double calculateHappiness(int agent, const Neighborhood<D>& neighborhood) const;
+    template <int D> double happinessAt(int agent, const double* position) const;
+
+    template <typename Function>
+    void forEachAgent(Function body);
+
+    template <int D> void linkAgents(const char* members = 0);
+    template <int D> int countClusters();
+    template <int D> void assignUnclaimedPoints();
+    template <int D> double averageClusterDistance() const;
+    template <int D> double exactAverageDistance() const;
+    template <int D> double sampledAverageDistance() const;
+    template <int D> static double distanceSum(const double* point, const double* const* columns,
+                                               int first, int count, int dimension);
 
     void sleep(int milliseconds);
 };
@@ -0,0 +1,62 @@
+#include "arena.h"
+
+Arena::Arena() {
+    m_current = 0;
+    m_offset = 0;
+}
+
+Arena::~Arena() {
+    release();
+    for (unsigned int i = 0; i < m_blocks.size(); i++)
+        ::operator delete(m_blocks[i].data, std::align_val_t(CACHE_LINE_SIZE));
+}
+
+/**
+ * @brief Arena::allocate Hands out raw memory from the current block, moving on to the next one (or
+ * adding one) when it doesn't fit. Requests bigger than BLOCK_SIZE get a block of their own size.
+ * @param size Number of bytes.
+ * @param alignment Required alignment, a power of two no larger than CACHE_LINE_SIZE.
+ * @return The memory, valid until the next release().
+ */
+void* Arena::allocate(size_t size, size_t alignment) {
+    while (m_current < m_blocks.size()) {
+        const Block& block = m_blocks[m_current];
+        size_t start = (m_offset + alignment - 1) & ~(alignment - 1);
+        if (start + size <= block.size) {
+            m_offset = start + size;
+            return block.data + start;
+        }
+        m_current++;
+        m_offset = 0;
+    }
+
+    Block block;
+    block.size = (size > BLOCK_SIZE) ? size : BLOCK_SIZE;
+    block.data = static_cast<char*>(::operator new(block.size, std::align_val_t(CACHE_LINE_SIZE)));
+    m_blocks.push_back(block);
+    m_current = m_blocks.size() - 1;
+    m_offset = size;
+    return block.data;
+}
+
+/**
+ * @brief Arena::release Destroys every object created since the last release, newest first, and
+ * rewinds to the start of the first block. The blocks are kept for reuse.
+ */
+void Arena::release() {
+    for (size_t i = m_destructors.size(); i > 0; i--)
+        m_destructors[i - 1].destroy(m_destructors[i - 1].object);
+    m_destructors.clear();
+    m_current = 0;
+    m_offset = 0;
+}
+
+/**
+ * @brief Arena::bytesReserved Total size of the blocks the arena holds.
+ */
+size_t Arena::bytesReserved() const {
+    size_t total = 0;
+    for (unsigned int i = 0; i < m_blocks.size(); i++)
+        total += m_blocks[i].size;
+    return total;
+}
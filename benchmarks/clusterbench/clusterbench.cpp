@@ -0,0 +1,202 @@
+#include "agentcluster.h"
+#include "faso.h"
+#include "radiuskernels.h"
+
+#include <QElapsedTimer>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * Times every phase of a clustering run on the bundled data sets, and FASO on both test functions,
+ * and writes the results as JSON so that builds can be compared.
+ *
+ * The clustering timings come from the run's Metrics: every timer, plus their total (update and moves
+ * are part of convergence, so they aren't counted twice).
+ * FASO is timed around start(), with its results file turned off, so only the solve is measured.
+ *
+ * Every trial runs with the same seed, so all trials (and all builds with the same algorithm) do the
+ * same work; only the timings vary. Each timing is reported as the min, median, mean and max over
+ * the trials, in milliseconds, along with the raw values.
+ *
+ * Usage: clusterbench [options]
+ *      --data <dir>        directory holding the data sets (default ../../test_data)
+ *      --output <file>     where to write the JSON (default clusterbench.json)
+ *      --trials <n>        runs per data set and function (default 3)
+ *      --iterations <n>    iterations per run (default 50)
+ *      --seed <n>          seed for every run (default 1)
+ *      -p                  run the clustering phases in parallel
+ */
+
+static const char* DATA_SETS[] = { "jain", "agreggation", "r15", "d31", "s1", "s2", "s3", "s4" };
+static const int FASO_BENCH_INSTANCES = 4;
+
+struct Options {
+    std::string data;
+    std::string output;
+    int trials;
+    int iterations;
+    unsigned long long seed;
+    bool parallel;
+
+    Options() : data("../../test_data"), output("clusterbench.json"), trials(3), iterations(50), seed(1),
+        parallel(false) {}
+};
+
+/**
+ * @brief writeTimings Writes one timing series as a JSON object: summary statistics plus the trials.
+ */
+static void writeTimings(FILE* file, std::vector<double> milliseconds) {
+    std::vector<double> sorted = milliseconds;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (unsigned int i = 0; i < sorted.size(); i++)
+        sum += sorted[i];
+    size_t middle = sorted.size() / 2;
+    double median = (sorted.size() % 2) ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) * 0.5;
+
+    fprintf(file, "{ \"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"max\": %.3f, \"trials\": [",
+            sorted.front(), median, sum / sorted.size(), sorted.back());
+    for (unsigned int i = 0; i < milliseconds.size(); i++)
+        fprintf(file, "%s%.3f", i ? ", " : "", milliseconds[i]);
+    fprintf(file, "] }");
+}
+
+/**
+ * @brief benchmarkDataSet Clusters one data set options.trials times and writes its JSON entry.
+ * @return False if the data set couldn't be loaded.
+ */
+static bool benchmarkDataSet(FILE* file, const Options& options, const char* name, bool first) {
+    std::string path = options.data + "/" + name + ".csv";
+    std::vector<std::vector<double> > timers(Metrics::TimerCount + 1);     //the last one is the total
+    int points = 0, dimension = 0, agents = 0, clusters = 0, iterationsRun = 0;
+    long long queries = 0;
+
+    for (int trial = 0; trial < options.trials; trial++) {
+        AgentCluster cluster(options.iterations);
+        cluster.setHeadless(true);
+        cluster.setParallel(options.parallel);
+        cluster.setSeed(options.seed);
+        cluster.setMetricsEnabled(true);
+
+        if (!cluster.loadData(path))
+            return false;
+        cluster.start();
+
+        const Metrics& metrics = cluster.metrics();
+        double total = 0;
+        for (int t = 0; t < Metrics::TimerCount; t++) {
+            double milliseconds = metrics.seconds((Metrics::Timer)t) * 1e3;
+            timers[t].push_back(milliseconds);
+            if (t != Metrics::Update && t != Metrics::Moves)
+                total += milliseconds;
+        }
+        timers[Metrics::TimerCount].push_back(total);
+        queries = metrics.counter(Metrics::NeighborQueries);
+
+        points = cluster.dataCount();
+        dimension = cluster.dimension();
+        agents = cluster.agentCount();
+        clusters = cluster.clusterCount();
+        iterationsRun = cluster.iterationsRun();
+    }
+
+    fprintf(file, "%s\n    { \"dataset\": \"%s\", \"points\": %i, \"dimension\": %i, \"iterations\": %i, "
+                  "\"agents\": %i, \"clusters\": %i, \"neighbor_queries\": %lld,\n      \"phases\": {",
+            first ? "" : ",", name, points, dimension, iterationsRun, agents, clusters, queries);
+    for (int t = 0; t <= Metrics::TimerCount; t++) {
+        const char* timer = (t < Metrics::TimerCount) ? Metrics::name((Metrics::Timer)t) : "total";
+        fprintf(file, "%s\n        \"%s\": ", t ? "," : "", timer);
+        writeTimings(file, timers[t]);
+    }
+    fprintf(file, "\n      } }");
+    return true;
+}
+
+/**
+ * @brief benchmarkFunction Runs FASO on one test function options.trials times and writes its JSON entry.
+ */
+static void benchmarkFunction(FILE* file, const Options& options, TestFunction function, const char* name, bool first) {
+    std::vector<double> milliseconds;
+    int iterationsRun = 0;
+    for (int trial = 0; trial < options.trials; trial++) {
+        FASO faso(options.iterations, FASO_BENCH_INSTANCES, -1, function);
+        faso.setHeadless(true);
+        faso.setSeed(options.seed);
+        faso.setResultsFile("");    //only the solve is timed, and the repo's results file is left alone
+
+        QElapsedTimer timer;
+        timer.start();
+        faso.start();
+        milliseconds.push_back(timer.nsecsElapsed() / 1e6);
+        iterationsRun = faso.iterationsRun();
+    }
+
+    fprintf(file, "%s\n    { \"function\": \"%s\", \"instances\": %i, \"iterations\": %i, \"time\": ",
+            first ? "" : ",", name, FASO_BENCH_INSTANCES, iterationsRun);
+    writeTimings(file, milliseconds);
+    fprintf(file, " }");
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (argument == "-p")
+            options.parallel = true;
+        else if (argument == "--data" && hasValue)
+            options.data = argv[++i];
+        else if (argument == "--output" && hasValue)
+            options.output = argv[++i];
+        else if (argument == "--trials" && hasValue)
+            options.trials = std::max(1, atoi(argv[++i]));
+        else if (argument == "--iterations" && hasValue)
+            options.iterations = std::max(1, atoi(argv[++i]));
+        else if (argument == "--seed" && hasValue)
+            options.seed = strtoull(argv[++i], 0, 10);
+        else {
+            printf("Usage: clusterbench [--data dir] [--output file.json] [--trials n] [--iterations n] [--seed n] [-p]\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    FILE* file = fopen(options.output.c_str(), "w");
+    if (!file) {
+        printf("Error: unable to write %s\n", options.output.c_str());
+        return 1;
+    }
+
+    fprintf(file, "{\n  \"benchmark\": \"clusterbench\",\n  \"trials\": %i,\n  \"iterations\": %i,\n  \"seed\": %llu,\n"
+                  "  \"parallel\": %s,\n  \"threads\": %i,\n  \"kernels\": \"%s\",\n  \"clustering\": [",
+            options.trials, options.iterations, options.seed, options.parallel ? "true" : "false",
+            QThreadPool::globalInstance()->maxThreadCount(), bestRadiusKernels().name);
+
+    bool first = true;
+    for (unsigned int d = 0; d < sizeof(DATA_SETS) / sizeof(DATA_SETS[0]); d++) {
+        if (benchmarkDataSet(file, options, DATA_SETS[d], first))
+            first = false;
+        else
+            printf("Skipping %s: could not be loaded from %s\n", DATA_SETS[d], options.data.c_str());
+    }
+
+    fprintf(file, "\n  ],\n  \"optimization\": [");
+    benchmarkFunction(file, options, Styblinski, "styblinski", true);
+    benchmarkFunction(file, options, Ackley, "ackley", false);
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+
+    printf("Wrote %s\n", options.output.c_str());
+    return 0;
+}
@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# End to end benchmark of the clustering phases and FASO, with JSON output
+#
+#-------------------------------------------------
+
+QT       -= gui
+
+TARGET = clusterbench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+include(../../core.pri)
+
+SOURCES += clusterbench.cpp
@@ -0,0 +1,83 @@
+#include "csvloader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+/**
+ * Measures CSV loading throughput, comparing CsvLoader against the getline/split/atof loop that
+ * AgentCluster::loadData used before it.
+ *
+ * Usage: csvbench [file.csv]
+ * Without a file, a synthetic file with a header, CSV_BENCH_ROWS rows and an extra label column is
+ * written to the working directory first (and removed afterwards).
+ */
+
+static const int CSV_BENCH_ROWS = 2000000;
+static const char* SYNTHETIC_FILE = "csvbench_synthetic.csv";
+
+static void writeSyntheticFile(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return;
+    fprintf(file, "x,y,label\n");
+    RandomStream random(1, 0, 0);
+    for (int i = 0; i < CSV_BENCH_ROWS; i++)
+        fprintf(file, "%.6f,%.6f,%d\n", random.uniform(-1e5, 1e5), random.uniform(-1e5, 1e5), i % 16);
+    fclose(file);
+}
+
+/**
+ * @brief legacyLoad The old line by line loader, minus its two-column restriction so that both
+ * loaders read the same points.
+ */
+static void legacyLoad(const std::string& path, Dataset& data) {
+    std::ifstream file(path.c_str());
+    while (file.good()) {
+        std::string line;
+        std::getline(file, line, '\n');
+        std::vector<std::string> columns = split(line, ',');
+        if (columns.size() < 2)
+            continue;
+        char* end = 0;
+        double x = strtod(columns[0].c_str(), &end);
+        if (end == columns[0].c_str())
+            continue;   //header
+        data.append(x, atof(columns[1].c_str()));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = (argc > 1) ? argv[1] : SYNTHETIC_FILE;
+    if (argc <= 1) {
+        printf("Writing %i synthetic rows to %s...\n", CSV_BENCH_ROWS, SYNTHETIC_FILE);
+        writeSyntheticFile(SYNTHETIC_FILE);
+    }
+
+    Dataset legacy;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    legacyLoad(path, legacy);
+    double legacySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Dataset mapped;
+    CsvLoadStats stats;
+    if (!CsvLoader::load(path, mapped, &stats, 2))     //the legacy loop only reads x and y
+        return 1;
+
+    bool identical = (legacy.size() == mapped.size() &&
+                      std::equal(legacy.x, legacy.x + legacy.size(), mapped.x) &&
+                      std::equal(legacy.y, legacy.y + legacy.size(), mapped.y));
+    double megabytes = stats.bytes / (1024.0 * 1024.0);
+    printf("%.1f MB, %i rows, %i skipped\n", megabytes, stats.rows, stats.skippedRows);
+    printf("getline/split/atof: %8.3f s %10.1f MB/s\n", legacySeconds, megabytes / legacySeconds);
+    printf("CsvLoader:          %8.3f s %10.1f MB/s (%.1fx)\n", stats.seconds, stats.megabytesPerSecond(),
+           legacySeconds / stats.seconds);
+    printf("Results %s\n", identical ? "match" : "DIFFER");
+
+    if (argc <= 1)
+        remove(SYNTHETIC_FILE);
+    return identical ? 0 : 1;
+}
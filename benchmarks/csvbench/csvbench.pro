@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Throughput benchmark for the CSV loader in csvloader.h
+#
+#-------------------------------------------------
+
+QT       += core concurrent
+QT       -= gui
+
+TARGET = csvbench
+CONFIG   += console c++17
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += csvbench.cpp \
+    ../../csvloader.cpp
+
+HEADERS += \
+    ../../csvloader.h \
+    ../../def.h \
+    ../../parallel.h
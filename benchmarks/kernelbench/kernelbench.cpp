@@ -0,0 +1,131 @@
+#include "radiuskernels.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Compares the radius kernels against the scalar sqrt(pow) test the indices used before them.
+ *
+ * For every data set, a query is run around every point with a radius of 1, 2 and 5 percent of the
+ * bounding box diagonal, counting the points in range with a plain scan over the whole set. The
+ * indexed kernels are timed on the same scan through a shuffled index list, which is the access
+ * pattern of the spatial grid.
+ *
+ * Usage: kernelbench [data directory] (defaults to ../../test_data)
+ */
+
+static const char* DATA_SETS[] = { "s1.csv", "s2.csv", "d31.csv", "r15.csv", "jain.csv", "agreggation.csv" };
+static const double RADIUS_FRACTIONS[] = { 0.01, 0.02, 0.05 };
+
+struct Points {
+    std::vector<double> x;
+    std::vector<double> y;
+};
+
+static bool loadPoints(const std::string& path, Points& points) {
+    std::ifstream file(path.c_str());
+    if (!file.is_open())
+        return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        double x, y;
+        char separator;
+        if (stream >> x >> separator >> y) {
+            points.x.push_back(x);
+            points.y.push_back(y);
+        }
+    }
+    return !points.x.empty();
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief scalarBaseline The range test the indices used before the kernels: sqrt(pow + pow) <= range.
+ */
+static int scalarBaseline(const double* xs, const double* ys, int count, double x, double y, double range) {
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        if (std::sqrt(std::pow(xs[i] - x, 2) + std::pow(ys[i] - y, 2)) <= range)
+            found++;
+    }
+    return found;
+}
+
+int main(int argc, char* argv[]) {
+    std::string directory = (argc > 1) ? argv[1] : "../../test_data";
+    printf("best kernels: %s\n\n", bestRadiusKernels().name);
+    printf("%-16s %8s %8s  %-14s %10s %8s %10s\n", "data set", "points", "radius", "kernel", "ms", "speedup", "checksum");
+
+    for (unsigned int d = 0; d < sizeof(DATA_SETS) / sizeof(DATA_SETS[0]); d++) {
+        Points points;
+        if (!loadPoints(directory + "/" + DATA_SETS[d], points)) {
+            printf("%-16s could not be loaded\n", DATA_SETS[d]);
+            continue;
+        }
+        int count = (int)points.x.size();
+        const double* xs = points.x.data();
+        const double* ys = points.y.data();
+
+        double minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0];
+        for (int i = 1; i < count; i++) {
+            minX = std::min(minX, xs[i]);
+            maxX = std::max(maxX, xs[i]);
+            minY = std::min(minY, ys[i]);
+            maxY = std::max(maxY, ys[i]);
+        }
+        double diagonal = std::sqrt((maxX - minX) * (maxX - minX) + (maxY - minY) * (maxY - minY));
+
+        std::vector<int> shuffled(count);
+        for (int i = 0; i < count; i++)
+            shuffled[i] = i;
+        srand(1);
+        for (int i = count - 1; i > 0; i--)
+            std::swap(shuffled[i], shuffled[rand() % (i + 1)]);
+
+        for (unsigned int r = 0; r < sizeof(RADIUS_FRACTIONS) / sizeof(RADIUS_FRACTIONS[0]); r++) {
+            double range = diagonal * RADIUS_FRACTIONS[r];
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            long long baselineSum = 0;
+            for (int q = 0; q < count; q++)
+                baselineSum += scalarBaseline(xs, ys, count, xs[q], ys[q], range);
+            double baselineMs = elapsedMs(start);
+            printf("%-16s %8d %8.3g  %-14s %10.1f %8s %10lld\n", DATA_SETS[d], count, range,
+                   "sqrt(pow)", baselineMs, "1.00x", baselineSum);
+
+            for (int level = SimdScalar; level <= SimdAVX512; level++) {
+                const RadiusKernels* kernels = radiusKernels((SimdLevel)level);
+                if (!kernels)
+                    continue;
+
+                start = std::chrono::steady_clock::now();
+                long long sum = 0;
+                for (int q = 0; q < count; q++)
+                    sum += kernels->count(xs, ys, count, xs[q], ys[q], range);
+                double ms = elapsedMs(start);
+                printf("%-16s %8s %8s  %-14s %10.1f %7.2fx %10lld\n", "", "", "",
+                       kernels->name, ms, baselineMs / ms, sum);
+
+                start = std::chrono::steady_clock::now();
+                sum = 0;
+                for (int q = 0; q < count; q++)
+                    sum += kernels->countIndexed(xs, ys, shuffled.data(), count, xs[q], ys[q], range, q);
+                ms = elapsedMs(start);
+                std::string name = std::string(kernels->name) + " indexed";
+                printf("%-16s %8s %8s  %-14s %10.1f %7.2fx %10lld\n", "", "", "",
+                       name.c_str(), ms, baselineMs / ms, sum + count);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Micro-benchmark for the radius kernels in radiuskernels.h
+#
+#-------------------------------------------------
+
+TARGET = kernelbench
+CONFIG   += console c++11
+CONFIG   -= app_bundle qt
+
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += kernelbench.cpp \
+    ../../radiuskernels.cpp
+
+HEADERS += \
+    ../../radiuskernels.h
@@ -0,0 +1,131 @@
+#include "binarydataset.h"
+
+#include <QFile>
+#include <QtGlobal>
+#include <cstring>
+#include <stdio.h>
+
+static const char BINARY_MAGIC[8] = { 'F', 'A', 'S', 'C', 'D', 'A', 'T', 'A' };
+
+/**
+ * @brief BinaryDataset::isBinary Checks whether a file starts with the binary dataset magic.
+ */
+bool BinaryDataset::isBinary(const std::string &path) {
+    QFile file(path.c_str());
+    if (!file.open(QFile::ReadOnly))
+        return false;
+    char magic[sizeof(BINARY_MAGIC)];
+    bool binary = file.read(magic, sizeof(magic)) == (qint64)sizeof(magic) &&
+                  memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0;
+    file.close();
+    return binary;
+}
+
+/**
+ * @brief BinaryDataset::load Maps a binary dataset and points the Dataset straight at its columns.
+ * Nothing is copied; the file stays mapped for as long as the Dataset uses it.
+ * @param path The filename of the file to load data from.
+ * @param data Dataset to replace the contents of.
+ * @return True for successful loading, false if the file couldn't be mapped or isn't a valid dataset
+ * of 2 to MAX_DIMENSIONS dimensions.
+ */
+bool BinaryDataset::load(const std::string &path, Dataset &data) {
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    printf("Error: binary datasets can only be mapped on little-endian machines\n");
+    return false;
+#endif
+    QFile* file = new QFile(path.c_str());
+    std::shared_ptr<QFile> owner(file, [](QFile* mapped) {
+        mapped->close();    //also drops the mapping
+        delete mapped;
+    });
+    if (!file->open(QFile::ReadOnly))
+        return false;
+
+    long long size = file->size();
+    const unsigned char* base = (size >= (long long)sizeof(Header)) ? file->map(0, size) : 0;
+    if (!base) {
+        printf("Error: unable to map binary dataset: %s\n", path.c_str());
+        return false;
+    }
+
+    static_assert(sizeof(Header) == 64, "the header is 64 bytes on disk");
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 || header.version != BINARY_DATASET_VERSION) {
+        printf("Error: %s is not a version %u binary dataset\n", path.c_str(), BINARY_DATASET_VERSION);
+        return false;
+    }
+    if (header.dimension < 2 || header.dimension > (unsigned int)MAX_DIMENSIONS) {
+        printf("Error: %s has %u dimensions, only 2 to %i are supported\n", path.c_str(), header.dimension,
+               MAX_DIMENSIONS);
+        return false;
+    }
+    if (header.count > (unsigned long long)0x7FFFFFFF) {
+        printf("Error: %s has too many points\n", path.c_str());
+        return false;
+    }
+
+    long long count = (long long)header.count;
+    long long offset = BINARY_COLUMN_ALIGNMENT;
+    std::vector<long long> columnOffsets(header.dimension);
+    for (unsigned int d = 0; d < header.dimension; d++) {
+        columnOffsets[d] = offset;
+        offset += columnBytes(count, sizeof(double));
+    }
+    if (offset > size) {
+        printf("Error: %s is truncated\n", path.c_str());
+        return false;
+    }
+
+    std::vector<const double*> columns(header.dimension);
+    for (unsigned int d = 0; d < header.dimension; d++)
+        columns[d] = (const double*)(base + columnOffsets[d]);
+    data.attachMapped(columns, (int)count, owner);
+    return true;
+}
+
+/**
+ * @brief BinaryDataset::save Writes a Dataset in the binary format.
+ * @param path The filename of the file to write.
+ * @param data The points to write.
+ * @return True if the whole file was written.
+ */
+bool BinaryDataset::save(const std::string &path, const Dataset &data) {
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    printf("Error: binary datasets can only be written on little-endian machines\n");
+    return false;
+#endif
+    QFile file(path.c_str());
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+        return false;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_DATASET_VERSION;
+    header.dimension = data.dimension();
+    header.count = data.size();
+
+    std::vector<char> padding(BINARY_COLUMN_ALIGNMENT, 0);
+    bool ok = file.write((const char*)&header, sizeof(header)) == (qint64)sizeof(header);
+    ok = ok && file.write(padding.data(), BINARY_COLUMN_ALIGNMENT - sizeof(header)) ==
+               (qint64)(BINARY_COLUMN_ALIGNMENT - sizeof(header));
+
+    const long long bytes = (long long)data.size() * sizeof(double);
+    const long long padded = columnBytes(data.size(), sizeof(double));
+    for (int d = 0; d < data.dimension() && ok; d++) {
+        ok = file.write((const char*)data.columns[d], bytes) == bytes;
+        ok = ok && file.write(padding.data(), padded - bytes) == padded - bytes;
+    }
+    file.close();
+    return ok;
+}
+
+/**
+ * @brief BinaryDataset::columnBytes Size of a column including the padding up to the next boundary.
+ */
+long long BinaryDataset::columnBytes(long long count, int valueSize) {
+    long long bytes = count * valueSize;
+    return (bytes + BINARY_COLUMN_ALIGNMENT - 1) / BINARY_COLUMN_ALIGNMENT * BINARY_COLUMN_ALIGNMENT;
+}
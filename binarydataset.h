@@ -0,0 +1,44 @@
+#ifndef BINARYDATASET_H
+#define BINARYDATASET_H
+
+#include "def.h"
+
+#include <string>
+
+/**
+ * @brief The BinaryDataset class Reads and writes the binary columnar dataset format, which can be
+ * memory mapped and used in place instead of being parsed.
+ * @details Layout, all values little-endian:
+ *
+ *      offset  size    field
+ *      0       8       magic, "FASCDATA"
+ *      8       4       format version (BINARY_DATASET_VERSION)
+ *      12      4       dimension, the number of coordinate columns
+ *      16      8       point count
+ *      24      40      reserved, zero
+ *      64              coordinate columns (float64), one per dimension
+ *
+ * Every column starts on a BINARY_COLUMN_ALIGNMENT byte boundary, counted from the start of the
+ * file. Mapped files are page aligned, so the columns can be used as arrays straight from the
+ * mapping: loading costs the same no matter how many points the file has.
+ */
+class BinaryDataset
+{
+public:
+    static bool isBinary(const std::string& path);
+    static bool load(const std::string& path, Dataset& data);
+    static bool save(const std::string& path, const Dataset& data);
+
+private:
+    struct Header {
+        char magic[8];
+        unsigned int version;
+        unsigned int dimension;
+        unsigned long long count;
+        unsigned char reserved[40];
+    };
+
+    static long long columnBytes(long long count, int valueSize);
+};
+
+#endif // BINARYDATASET_H
@@ -2,21 +2,24 @@
 #include "agentcluster.h"
 #include "ui_clustercanvas.h"
 
-#include <QGraphicsEllipseItem>
-#include <QPropertyAnimation>
+#include <QGraphicsPixmapItem>
+#include <QElapsedTimer>
 #include <QThread>
 #include <QFile>
 #include <QTextStream>
 
-
+#include <algorithm>
 #include <stdio.h>
 
 /**
- * @brief ClusterCanvas::ClusterCanvas Visualization class that takes care of showing ClusterItem
- * and Agent objects on a scaled 2d canvas.
- * @param dataSource Filename of csv file containing cluster data
- * @param iterations Number of iterations to run for.
- * @param parent Parent QObject
+ * @brief ClusterCanvas::ClusterCanvas Visualization class that takes care of showing data points
+ * and agents on a scaled 2d canvas.
+ * @details The canvas never touches the solver's swarm: the solver publishes copies to a SnapshotRing
+ * (see watch()), and the canvas draws the newest one whenever it gets round to it.
+ * Each kind of thing on the canvas (data, agents, foraging and crowding ranges) is a single
+ * PointLayer item painting from a buffer, and one animation slides all of the agent layers from one
+ * update to the next.
+ * @param parent Parent QWidget
  */
 ClusterCanvas::ClusterCanvas(QWidget *parent) :
     QMainWindow(parent),
@@ -26,397 +29,310 @@ ClusterCanvas::ClusterCanvas(QWidget *parent) :
 
     m_view = ui->graphicsView;
     m_scene = new QGraphicsScene(m_view);
+    m_scene->setItemIndexMethod(QGraphicsScene::NoIndex);   //a handful of items that cover everything
     m_view->setScene(m_scene);
     m_view->setRenderHint(QPainter::Antialiasing, true);
-
+    m_view->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+
+    m_dataLayer = new PointLayer(PointLayer::Dots);
+    m_dataLayer->setColor(Qt::blue);
+    m_dataLayer->setOutline(Qt::black);
+    m_dataLayer->setDotSize(2.5);
+    m_dataLayer->setZValue(0);
+    m_dataLayer->setCacheMode(QGraphicsItem::DeviceCoordinateCache);   //drawn once, then only blitted
+
+    m_agentLayer = new PointLayer(PointLayer::Dots);
+    m_agentLayer->setColor(Qt::red);
+    m_agentLayer->setOutline(Qt::black);
+    m_agentLayer->setDotSize(AGENT_SIZE);
+    m_agentLayer->setTrails(SHOW_PATH);
+    m_agentLayer->setZValue(1);
+
+    m_forageLayer = new PointLayer(PointLayer::Circles);
+    m_forageLayer->setPen(Qt::NoPen);
+    m_forageLayer->setBrush(QColor(0, 0, 0, 50));
+    m_forageLayer->setZValue(2);
+
+    m_crowdingLayer = new PointLayer(PointLayer::Circles);
+    m_crowdingLayer->setPen(QPen(QColor(255, 0, 0, 128), 1));
+    m_crowdingLayer->setBrush(Qt::NoBrush);
+    m_crowdingLayer->setZValue(3);
+
+    m_scene->addItem(m_dataLayer);
+    m_scene->addItem(m_agentLayer);
+    m_scene->addItem(m_forageLayer);
+    m_scene->addItem(m_crowdingLayer);
+
+    m_animation = new QVariantAnimation(this);
+    m_animation->setStartValue(0.0);
+    m_animation->setEndValue(1.0);
+    m_animation->setDuration(MOVEMENT_DELAY - 1);
+    connect(m_animation, SIGNAL(valueChanged(QVariant)), this, SLOT(setAnimationProgress(QVariant)));
+
+    m_snapshots = 0;
+    m_data = 0;
     m_minX = m_maxX = m_minY = m_maxY = -1;
     m_calculatedDataRange = false;
+    m_drawAbsolute = true;
     m_function = Styblinski;
 }
 
 ClusterCanvas::~ClusterCanvas()
 {
     printf("deleting ClusterCanvas...\n");
+    reportFrameTimes();
+    m_animation->stop();
     if (m_scene)
         m_scene->clear();
 
-    m_dataItems.clear();
-
-
     delete ui;
 }
 
 
 
 /**
- * @brief ClusterCanvas::updateDisplay Display the given ClusterItems and Agents to a QGraphicsView for
- * visual inspection.
- * @param items A vector of ClusterItem objects. This is the dataset that the algorithm clustered.
- * @param agents A vector of Agent objects. These are displayed larger than the ClusterItems.
+ * @brief ClusterCanvas::watch Sets where showLatestSnapshot() takes the swarm from.
+ * @param snapshots The solver's snapshot ring.
+ * @param data The dataset being clustered, or 0 to draw the swarm over the test function instead.
  */
-void ClusterCanvas::updateDisplay(std::vector<ClusterItem*>* items, std::vector<Agent*>* agents) {
-    if (items->size() == 0)
-        return;
-
-
-    if (!isVisible()) {
-        show();
-        QRectF boundingArea =QRectF(0, 0, CANVAS_SIZE, CANVAS_SIZE);
-        m_view->setSceneRect(boundingArea);
-    }
-
-    //Shift everything so that (0, 0) is the smallest x/y position. For viewing purposes
-    if (!m_calculatedDataRange) {
-        m_minX = (*items)[0]->x;
-        m_minY = (*items)[0]->y;
-        m_maxX = m_minX;
-        m_maxY = m_minY;
-        for (unsigned int i = 0; i < items->size(); i++) {
-            ClusterItem* item = (*items)[i];
-            if (item->x < m_minX)
-                m_minX = item->x;
-            else if (item->x > m_maxX)
-                m_maxX = item->x;
-
-            if (item->y < m_minY)
-                m_minY = item->y;
-            else if (item->y > m_maxY)
-                m_maxY = item->y;
-        }
-        m_calculatedDataRange = true;
-
-        printf("\tupdated data in view...\n");
-    } else
-        printf("\tnot updating data in view...\n");
-
-    double rangeX = m_maxX - m_minX;
-    double rangeY = m_maxY - m_minY;
-
-    qreal minWidth = m_view->mapToScene(0, 0).x();
-    qreal minHeight = m_view->mapToScene(0, 0).y();
-    qreal maxWidth =m_view->mapToScene(m_view->width(), m_view->width()).x();
-    qreal maxHeight = m_view->mapToScene(m_view->height(), m_view->height()).x();
+void ClusterCanvas::watch(SnapshotRing *snapshots, const Dataset *data) {
+    m_snapshots = snapshots;
+    m_data = data;
+}
 
+/**
+ * @brief ClusterCanvas::showLatestSnapshot Draws the newest swarm snapshot (and the data under it),
+ * unless there's nothing new since the last one. Connect the solver's snapshotReady() signal to it.
+ */
+void ClusterCanvas::showLatestSnapshot() {
+    if (!m_snapshots)
+        return;
+    const SwarmSnapshot* agents = m_snapshots->acquire();
+    if (!agents)
+        return;
+    if (m_data && m_dataLayer->count() == 0)
+        drawData(m_data);
+    drawAgents(*agents);
+}
 
-    QBrush brush(Qt::blue);
-    QPen pen(Qt::black, 1);
+/**
+ * @brief ClusterCanvas::drawData Display the given data points to a QGraphicsView for visual
+ * inspection. Only done once; the data doesn't move.
+ * @param items The dataset that the algorithm clustered.
+ */
+void ClusterCanvas::drawData(const Dataset* items) {
+    if (items->size() == 0)
+        return;
 
-    double yMidline = m_view->sceneRect().height() / 2;
+    fitDataRange(items);
 
-    if (m_dataItems.size() == 0 && SHOW_DATA) {
-        for (unsigned int i = 0; i < items->size(); i++) {
-            QGraphicsEllipseItemObject* item = new QGraphicsEllipseItemObject(0);
-            ClusterItem* clusterItem = (*items)[i];
-            double pX = ((maxWidth - minWidth) * (clusterItem->x - m_minX)) / (rangeX) + minWidth;
-            double pY = ((maxHeight - minHeight) * (clusterItem->y - m_minY)) / (rangeY) + minHeight;
-            pY -= 2 * (pY - yMidline);
-
-            item->setRect(QRectF(pX, pY, 2.5, 2.5));
-            item->setBrush(brush);
-            item->setPen(pen);
-            m_scene->addItem(item);
-            item->show();
-            m_dataItems.push_back(item);
-        }
+    if (m_dataLayer->count() == 0 && SHOW_DATA) {
+        Projection view = projection();
+        m_centers.resize(items->size());
+        for (int i = 0; i < items->size(); i++)
+            m_centers[i] = view.map(items->x[i], items->y[i]);
+        m_dataLayer->setTargets(m_centers);
+        m_dataLayer->setProgress(1);
     }
-
-    updateDisplay(agents);
 }
 
-void ClusterCanvas::updateDisplay(std::vector<Agent *> *agents) {
-
-    bool drawAbsolute = false;
-    double contourScale = 4.0;
-    if (m_maxX == -1 && m_minX == -1 && m_maxY == -1 && m_minY == -1)
-        drawAbsolute = true;
+/**
+ * @brief ClusterCanvas::drawAgents Moves the agents (and their ranges, if shown) to their new
+ * positions. Without a data range, the swarm is drawn in absolute coordinates over the contour map of
+ * the test function.
+ * @details The time each update takes, including the repaint, is kept and reported by
+ * reportFrameTimes(). The viewport is repainted right away: the scene only hands its changes to the
+ * view later, from the event loop, so repainting the window alone wouldn't draw the new frame.
+ */
+void ClusterCanvas::drawAgents(const SwarmSnapshot &agents) {
+    QElapsedTimer frameTimer;
+    frameTimer.start();
 
-    if (!isVisible() && drawAbsolute) {
+    if (!isVisible() && m_drawAbsolute) {
         show();
         QRectF boundingArea =QRectF(0, 0, CANVAS_SIZE, CANVAS_SIZE);
         m_view->setSceneRect(boundingArea);
 
         QPixmap contour;     //Pick a contour map to overlay on
-        if (m_function == Styblinski) {
+        if (m_function == Styblinski)
             contour.load(":styblinski_contour.png");
-            contourScale = 5.0;
-        } else if (m_function == Ackley) {
+        else if (m_function == Ackley)
             contour.load(":ackley_contour.png");
-            contourScale = 4.0;
-        }
 
         contour = contour.scaled(CANVAS_SIZE, CANVAS_SIZE, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
         QGraphicsPixmapItem* item = new QGraphicsPixmapItem(contour);
+        item->setZValue(-1);
         m_scene->addItem(item);
         item->show();
         item->setPos(m_view->mapToScene(0, 0));
     }
 
-    printf("Updating...\n");
-    double rangeX = m_maxX - m_minX;
-    double rangeY = m_maxY - m_minY;
-
-    qreal minWidth = m_view->mapToScene(0, 0).x();
-    qreal minHeight = m_view->mapToScene(0, 0).y();
-    qreal maxWidth =m_view->mapToScene(m_view->width(), m_view->width()).x();
-    qreal maxHeight = m_view->mapToScene(m_view->height(), m_view->height()).x();
-
-    double xConversion = maxWidth / contourScale;
-    double yConversion = maxHeight / contourScale;
-
-    QBrush brush(Qt::blue);
-    QPen pen(Qt::black, 1);
-
-    double yMidline = m_view->sceneRect().height() / 2;
-
-    //Go through and draw each agent, and related structures
-    for (unsigned int i = 0; i < agents->size(); i++) {
-        Agent* agent = (*agents)[i];
-        AgentVisualizer* visualizer = 0;
-        if (m_agentVisualizers.contains(agent))
-            visualizer = m_agentVisualizers.value(agent);
-        else {
-            visualizer = new AgentVisualizer();
-            m_agentVisualizers.insert(agent, visualizer);
-        }
-
-        //Draw the agent itself...
-        QGraphicsEllipseItemObject* radiusItem = 0;
-        brush.setColor(Qt::red);
-        if (visualizer->agent)
-            radiusItem = visualizer->agent;
-        else {
-            radiusItem = new QGraphicsEllipseItemObject(0);
-            radiusItem->setBrush(brush);
-            radiusItem->setPen(pen);
-            radiusItem->setRect(0, 0, AGENT_SIZE, AGENT_SIZE);
-            m_scene->addItem(radiusItem);
-            radiusItem->show();
-            visualizer->agent = radiusItem;
-        }
-
-        double pX;
-        double pY;
-        if (drawAbsolute) {
-            pX = ((agent->x) * xConversion) - (radiusItem->boundingRect().width() / 2.0) + (CANVAS_SIZE / 2);
-            pY = ((agent->y) * yConversion) - (radiusItem->boundingRect().width() / 2.0) + (CANVAS_SIZE / 2);
-        } else {
-            pX = (((maxWidth - minWidth) * (agent->x - m_minX)) / (rangeX) + minWidth) - (radiusItem->boundingRect().width() / 2.0);
-            pY = (((maxHeight - minHeight) * (agent->y - m_minY)) / (rangeY) + minHeight) - (radiusItem->boundingRect().height() / 2.0);
-        }
-        pY -= 2 * (pY - yMidline);
-
-        Q_ASSERT_X(nanTest(pX), "Failed NaN", __FUNCTION__);
-        Q_ASSERT_X(nanTest(pY), "Failed NaN", __FUNCTION__);
-
-
-        if (SHOW_PATH) {    //And the path, if selected
-            QGraphicsLineItemObject* trail = 0;
-            if (visualizer->trail)
-                trail = visualizer->trail;
-            else {
-                trail = new QGraphicsLineItemObject(0);
-                trail->setPen(pen);
-                m_scene->addItem(trail);
-                trail->show();
-                visualizer->trail = trail;
-            }
-            trail->setLine(radiusItem->x(), radiusItem->y(), pX, pY);
-        }
-
-        if (ANIMATED) {
-            QPropertyAnimation* mover = new QPropertyAnimation(radiusItem, "pos");
-            mover->setDuration(MOVEMENT_DELAY - 1);
-            mover->setStartValue(radiusItem->pos());
-            mover->setEndValue(QPointF(pX, pY));
-            mover->start(QAbstractAnimation::DeleteWhenStopped);
-        } else {
-            radiusItem->setPos(pX, pY);
-        }
-
-
-        ////////Draw the forage range
-        brush.setColor(QColor(0, 0, 0, 50));
-        pen.setColor(Qt::transparent);
-        pen.setStyle(Qt::DashLine);
-        if (SHOW_FORAGE_RANGE) {
-            radiusItem = 0;
-            if (visualizer->forageRange)
-                radiusItem = visualizer->forageRange;
-            else {
-                radiusItem = new QGraphicsEllipseItemObject(0);
-                radiusItem->setBrush(brush);
-                radiusItem->setPen(pen);
-                m_scene->addItem(radiusItem);
-                radiusItem->show();
-                visualizer->forageRange = radiusItem;
-            }
-
-            double radius = agent->foragingRange;
-
-            double topLeftX;
-            double topLeftY;
-            double bottomRightX;
-            double bottomRightY;
-            if (drawAbsolute) {
-                topLeftX = (pX + (visualizer->agent->boundingRect().width() / 2)) - (radius * xConversion);
-                topLeftY = (pY - (visualizer->agent->boundingRect().height() / 2)) - (radius * yConversion);
-                bottomRightX = (pX + (visualizer->agent->boundingRect().width() / 2)) + (radius * xConversion);
-                bottomRightY = (pY - (visualizer->agent->boundingRect().height() / 2)) + (radius * yConversion);
-            } else {
-                topLeftX = ((maxWidth - minWidth) * ((agent->x - radius) - m_minX)) / (rangeX) + minWidth;
-                topLeftY = ((maxHeight - minHeight) * ((agent->y - radius) - m_minY)) / (rangeY) + minHeight;
-                bottomRightX = ((maxWidth - minWidth) * ((agent->x + radius) - m_minX)) / (rangeX) + minWidth;
-                bottomRightY = ((maxHeight - minHeight) * ((agent->y + radius) - m_minY)) / (rangeY) + minHeight;
-                topLeftY -= 2 * (topLeftY - yMidline);
-                bottomRightY -= 2 * (bottomRightY - yMidline);
-
-            }
-
+    Projection view = projection();
+    const int count = agents.size();
+    m_centers.resize(count);
+    for (int i = 0; i < count; i++) {
+        m_centers[i] = view.map(agents.x[i], agents.y[i]);
+        Q_ASSERT_X(nanTest(m_centers[i].x()), "Failed NaN", __FUNCTION__);
+        Q_ASSERT_X(nanTest(m_centers[i].y()), "Failed NaN", __FUNCTION__);
+    }
 
-            Q_ASSERT_X(nanTest(topLeftX), "Failed NaN", __FUNCTION__);
-            Q_ASSERT_X(nanTest(topLeftY), "Failed NaN", __FUNCTION__);
-            Q_ASSERT_X(nanTest(bottomRightX), "Failed NaN", __FUNCTION__);
-            Q_ASSERT_X(nanTest(bottomRightY), "Failed NaN", __FUNCTION__);
+    //Stopping leaves the layers where the last move got to, which is where the next one starts
+    m_animation->stop();
+    m_agentLayer->setTargets(m_centers);
+    if (SHOW_FORAGE_RANGE) {
+        m_radii.resize(count);
+        for (int i = 0; i < count; i++)
+            m_radii[i] = view.radius(agents.foragingRange[i]);
+        m_forageLayer->setTargets(m_centers, m_radii);
+    }
+    if (SHOW_CROWDING_RANGE) {
+        m_radii.resize(count);
+        for (int i = 0; i < count; i++)
+            m_radii[i] = view.radius(agents.crowdingRange[i]);
+        m_crowdingLayer->setTargets(m_centers, m_radii);
+    }
 
+    if (ANIMATED)
+        m_animation->start();
+    else
+        setAnimationProgress(1.0);
+    m_view->viewport()->repaint();
 
-            double ellipseWidth = bottomRightX - topLeftX;
-            double ellipseHeight = bottomRightY - topLeftY;
+    m_frameTimes.push_back(frameTimer.nsecsElapsed() / 1e6);
+}
 
-            double startX = visualizer->agent->x() - (ellipseWidth / 2);
-            double startY = visualizer->agent->y() - (ellipseHeight / 2);
+/**
+ * @brief ClusterCanvas::setAnimationProgress Moves every agent layer the given fraction of the way to
+ * its latest positions.
+ */
+void ClusterCanvas::setAnimationProgress(const QVariant &progress) {
+    qreal t = progress.toReal();
+    m_agentLayer->setProgress(t);
+    m_forageLayer->setProgress(t);
+    m_crowdingLayer->setProgress(t);
+}
 
-            radiusItem->setRect(0, 0, ellipseWidth, ellipseHeight);
-            if (ANIMATED) {
-                QPropertyAnimation* mover = new QPropertyAnimation(radiusItem, "pos");
-                mover->setDuration(MOVEMENT_DELAY - 1);
+/**
+ * @brief ClusterCanvas::fitDataRange Shows the canvas if it isn't yet, and works out the range of the
+ * data the first time it is called, so that clusters can be drawn even if no swarm ever was.
+ */
+void ClusterCanvas::fitDataRange(const Dataset* items) {
+    if (!isVisible()) {
+        show();
+        QRectF boundingArea =QRectF(0, 0, CANVAS_SIZE, CANVAS_SIZE);
+        m_view->setSceneRect(boundingArea);
+    }
 
-                QPointF startingPoint = QPointF(startX, startY) + QPointF(visualizer->agent->boundingRect().width() / 2, visualizer->agent->boundingRect().height() / 2);
-                mover->setStartValue(startingPoint);
-                mover->setEndValue(QPointF(topLeftX, topLeftY) + QPointF(0, visualizer->agent->boundingRect().height()));
-                mover->start(QAbstractAnimation::DeleteWhenStopped);
-            } else {
-                radiusItem->setPos(topLeftX, topLeftY);
-            }
+    //Shift everything so that (0, 0) is the smallest x/y position. For viewing purposes
+    if (!m_calculatedDataRange) {
+        m_minX = items->x[0];
+        m_minY = items->y[0];
+        m_maxX = m_minX;
+        m_maxY = m_minY;
+        for (int i = 0; i < items->size(); i++) {
+            double x = items->x[i];
+            double y = items->y[i];
+            if (x < m_minX)
+                m_minX = x;
+            else if (x > m_maxX)
+                m_maxX = x;
+
+            if (y < m_minY)
+                m_minY = y;
+            else if (y > m_maxY)
+                m_maxY = y;
         }
+        m_calculatedDataRange = true;
+        m_drawAbsolute = false;
 
-
-        pen.setColor(QColor(255, 0, 0, 128));
-        brush.setColor(Qt::transparent);
-        if (SHOW_CROWDING_RANGE) {
-            radiusItem = 0;
-            if (visualizer->crowdingRange)
-                radiusItem = visualizer->crowdingRange;
-            else {
-                radiusItem = new QGraphicsEllipseItemObject(0);
-                radiusItem->setBrush(brush);
-                radiusItem->setPen(pen);
-                m_scene->addItem(radiusItem);
-                radiusItem->show();
-                visualizer->crowdingRange = radiusItem;
-            }
-            double radius = agent->crowdingRange;
-            double topLeftX;
-            double topLeftY;
-            double bottomRightX;
-            double bottomRightY;
-            if (drawAbsolute) {
-                topLeftX = (pX + (visualizer->agent->boundingRect().width() / 2)) - (radius * xConversion);
-                topLeftY = (pY - (visualizer->agent->boundingRect().height() / 2)) - (radius * yConversion);
-                bottomRightX = (pX + (visualizer->agent->boundingRect().width() / 2)) + (radius * xConversion);
-                bottomRightY = (pY - (visualizer->agent->boundingRect().height() / 2)) + (radius * yConversion);
-            } else {
-                topLeftX = ((maxWidth - minWidth) * ((agent->x - radius) - m_minX)) / (rangeX) + minWidth;
-                topLeftY = ((maxHeight - minHeight) * ((agent->y - radius) - m_minY)) / (rangeY) + minHeight;
-                bottomRightX = ((maxWidth - minWidth) * ((agent->x + radius) - m_minX)) / (rangeX) + minWidth;
-                bottomRightY = ((maxHeight - minHeight) * ((agent->y + radius) - m_minY)) / (rangeY) + minHeight;
-                topLeftY -= 2 * (topLeftY - yMidline);
-                bottomRightY -= 2 * (bottomRightY - yMidline);
-            }
-
-
-            Q_ASSERT_X(nanTest(topLeftX), "Failed NaN", __FUNCTION__);
-            Q_ASSERT_X(nanTest(topLeftY), "Failed NaN", __FUNCTION__);
-            Q_ASSERT_X(nanTest(bottomRightX), "Failed NaN", __FUNCTION__);
-            Q_ASSERT_X(nanTest(bottomRightY), "Failed NaN", __FUNCTION__);
-
-
-            double ellipseWidth = bottomRightX - topLeftX;
-            double ellipseHeight = bottomRightY - topLeftY;
-
-            double startX = visualizer->agent->x() - (ellipseWidth / 2);
-            double startY = visualizer->agent->y() - (ellipseHeight / 2);
-
-            radiusItem->setRect(0, 0, ellipseWidth, ellipseHeight);
-
-            if (ANIMATED) {
-                QPropertyAnimation* mover = new QPropertyAnimation(radiusItem, "pos");
-                mover->setDuration(MOVEMENT_DELAY - 1);
-
-                QPointF startingPoint = QPointF(startX, startY) + QPointF(visualizer->agent->boundingRect().width() / 2, visualizer->agent->boundingRect().height() / 2);
-                mover->setStartValue(startingPoint);
-                mover->setEndValue(QPointF(topLeftX, topLeftY) + QPointF(0, visualizer->agent->boundingRect().height()));
-                mover->start(QAbstractAnimation::DeleteWhenStopped);
-            } else {
-                radiusItem->setPos(topLeftX, topLeftY);
-            }
-
-        }
+        printf("\tupdated data in view...\n");
     }
-    repaint();
-
 }
 
-void ClusterCanvas::setClusters(std::vector<Cluster*>* clusters) {
-    printf("\n\nReceived %i clusters\n", clusters->size());
-    for (unsigned int i = 0; i < m_dataItems.size(); i++) {
-        QGraphicsEllipseItemObject* item = m_dataItems[i];
-        item->hide();
-        m_scene->removeItem(item);
-        delete item;
-    }
-    m_dataItems.clear();
-
+/**
+ * @brief ClusterCanvas::projection Works out how solver coordinates map onto the scene: the data
+ * range stretched over the view, or for FASO, the function's domain over the contour map.
+ */
+ClusterCanvas::Projection ClusterCanvas::projection() const {
+    qreal minWidth = m_view->mapToScene(0, 0).x();
+    qreal minHeight = m_view->mapToScene(0, 0).y();
+    qreal maxWidth =m_view->mapToScene(m_view->width(), m_view->width()).x();
+    qreal maxHeight = m_view->mapToScene(m_view->height(), m_view->height()).x();
+    double yMidline = m_view->sceneRect().height() / 2;
 
-    for (QHash<Agent*, AgentVisualizer*>::iterator i = m_agentVisualizers.begin(); i != m_agentVisualizers.end(); i++) {
-        AgentVisualizer* vis = (*i);
-        delete vis;
+    Projection view;
+    if (m_drawAbsolute) {
+        double contourScale = (m_function == Styblinski) ? 5.0 : 4.0;
+        view.scaleX = maxWidth / contourScale;
+        view.scaleY = -maxHeight / contourScale;
+        view.offsetX = CANVAS_SIZE / 2;
+        view.offsetY = 2 * yMidline - CANVAS_SIZE / 2;
+        return view;
     }
-    m_agentVisualizers.clear();
 
     double rangeX = m_maxX - m_minX;
     double rangeY = m_maxY - m_minY;
+    view.scaleX = (maxWidth - minWidth) / rangeX;
+    view.offsetX = minWidth - m_minX * view.scaleX;
+    view.scaleY = -(maxHeight - minHeight) / rangeY;    //flipped around the midline
+    view.offsetY = 2 * yMidline - minHeight - m_minY * view.scaleY;
+    return view;
+}
 
-    qreal minWidth = m_view->mapToScene(0, 0).x();
-    qreal minHeight = m_view->mapToScene(0, 0).y();
-    qreal maxWidth =m_view->mapToScene(m_view->width(), m_view->width()).x();
-    qreal maxHeight = m_view->mapToScene(m_view->height(), m_view->height()).x();
-
-    double yMidline = m_view->sceneRect().height() / 2;
+/**
+ * @brief ClusterCanvas::reportFrameTimes Prints how long the updates since the last report took, then
+ * starts over.
+ */
+void ClusterCanvas::reportFrameTimes() {
+    if (m_frameTimes.empty())
+        return;
+    std::vector<double> sorted = m_frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (unsigned int i = 0; i < sorted.size(); i++)
+        sum += sorted[i];
+    printf("Rendered %i frames: mean %.3f ms, median %.3f ms, max %.3f ms\n", (int)sorted.size(),
+           sum / sorted.size(), sorted[sorted.size() / 2], sorted.back());
+    m_frameTimes.clear();
+}
 
+void ClusterCanvas::setClusters(std::vector<Cluster*>* clusters, Dataset* data) {
+    printf("\n\nReceived %i clusters\n", (int)clusters->size());
+    if (data->size() == 0)
+        return;
+    fitDataRange(data);
+    reportFrameTimes();
+
+    //The agents are done; only the clustered data stays
+    m_animation->stop();
+    std::vector<QPointF> none;
+    m_agentLayer->setTargets(none);
+    m_forageLayer->setTargets(none);
+    m_crowdingLayer->setTargets(none);
+
+    Projection view = projection();
+    std::vector<PointLayer::Run> runs;
+    m_centers.clear();
     for (unsigned int i = 0; i < clusters->size(); i++) {
         Cluster* cluster = (*clusters)[i];
         int r = rand() % 255;
         int g = rand() % 255;
         int b = rand() % 255;
-        QColor color = QColor(r, g, b);
 
         for (unsigned int j = 0; j < cluster->points.size(); j++) {
-            QGraphicsEllipseItemObject* item = new QGraphicsEllipseItemObject(0);
-            ClusterItem* clusterItem = cluster->points[j];
-            double pX = ((maxWidth - minWidth) * (clusterItem->x - m_minX)) / (rangeX) + minWidth;
-            double pY = ((maxHeight - minHeight) * (clusterItem->y - m_minY)) / (rangeY) + minHeight;
-            pY -= 2 * (pY - yMidline);
-
-            pX -= (DATAPOINT_SIZE / 2);
-            pY -= (DATAPOINT_SIZE / 2);
-            item->setRect(QRectF(pX, pY, DATAPOINT_SIZE, DATAPOINT_SIZE));
-            item->setBrush(QBrush(color));
-            item->setPen(QPen(color));
-            m_scene->addItem(item);
-            item->show();
-            m_dataItems.push_back(item);
+            int point = cluster->points[j];
+            m_centers.push_back(view.map(data->x[point], data->y[point]));
         }
+        PointLayer::Run run;
+        run.end = (int)m_centers.size();
+        run.color = QColor(r, g, b);
+        runs.push_back(run);
     }
+    m_dataLayer->setOutline(Qt::transparent);
+    m_dataLayer->setDotSize(DATAPOINT_SIZE);
+    m_dataLayer->setRuns(runs);
+    m_dataLayer->setTargets(m_centers);
+    m_dataLayer->setProgress(1);
 
 
     QFile file("../AgentCluster/test_data/cluster_results.csv");
@@ -425,8 +341,8 @@ void ClusterCanvas::setClusters(std::vector<Cluster*>* clusters) {
         for (unsigned int i = 0; i < clusters->size(); i++) {
             Cluster* cluster = (*clusters)[i];
             for (unsigned int j = 0; j < cluster->points.size(); j++) {
-                ClusterItem* item = cluster->points[j];
-                stream << item->x << "," << item->y << "," << item->group << "\n";
+                int point = cluster->points[j];
+                stream << data->x[point] << "," << data->y[point] << "," << data->group[point] << "\n";
             }
         }
         file.close();
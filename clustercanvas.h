@@ -3,13 +3,13 @@
 
 #include "def.h"
 #include "faso.h"
-#include "gui/qgraphicsellipseitemobject.h"
-#include "gui/qgraphicslineitemobject.h"
+#include "snapshotring.h"
+#include "gui/pointlayer.h"
 
 #include <QMainWindow>
-#include <QHash>
 #include <QGraphicsView>
 #include <QGraphicsScene>
+#include <QVariantAnimation>
 
 class AgentCluster;
 namespace Ui {
@@ -24,59 +24,64 @@ public:
     explicit ClusterCanvas(QWidget *parent = 0);
     ~ClusterCanvas();
     void setFunction(TestFunction function) { m_function = function; }
+    void watch(SnapshotRing* snapshots, const Dataset* data = 0);
 
 public slots:
-    void updateDisplay(std::vector<ClusterItem*>* items, std::vector<Agent*>* agents);
-    void updateDisplay(std::vector<Agent*>* agents);
-    void setClusters(std::vector<Cluster*>* clusters);
+    void showLatestSnapshot();
+    void setClusters(std::vector<Cluster*>* clusters, Dataset* data);
+
+private slots:
+    void setAnimationProgress(const QVariant& progress);
 
 private:
-    struct AgentVisualizer {
-        QGraphicsEllipseItemObject* agent;
-        QGraphicsEllipseItemObject* forageRange;
-        QGraphicsEllipseItemObject* crowdingRange;
-        QGraphicsLineItemObject* trail;
-
-        AgentVisualizer() {
-            agent = forageRange = crowdingRange = 0;
-            trail = 0;
-        }
-        ~AgentVisualizer() {
-            if (agent) {
-                agent->hide();
-                delete agent;
-            }
-            if (forageRange) {
-                forageRange->hide();
-                delete forageRange;
-            }
-            if (crowdingRange) {
-                crowdingRange->hide();
-                delete crowdingRange;
-            }
-            if (trail) {
-                trail->hide();
-                delete trail;
-            }
-        }
+    /**
+     * Maps solver coordinates to the scene: scene = coordinate * scale + offset, per axis. The y
+     * scale is negative, so that y grows upwards on screen.
+     */
+    struct Projection {
+        double scaleX;
+        double scaleY;
+        double offsetX;
+        double offsetY;
+
+        QPointF map(double x, double y) const { return QPointF(x * scaleX + offsetX, y * scaleY + offsetY); }
+        QSizeF radius(double r) const { return QSizeF(r * std::fabs(scaleX), r * std::fabs(scaleY)); }
     };
 
     TestFunction m_function;
 
     Ui::ClusterCanvas *ui;
 
+    SnapshotRing* m_snapshots;  //where the solver publishes the swarm
+    const Dataset* m_data;      //drawn under the swarm, if set; doesn't change while the solver runs
+
     QGraphicsView* m_view;
     QGraphicsScene* m_scene;
 
-    std::vector<QGraphicsEllipseItemObject*> m_dataItems;
-    QHash<Agent*, AgentVisualizer*> m_agentVisualizers;
+    //One item per layer, drawn bottom to top; the scene owns them
+    PointLayer* m_dataLayer;
+    PointLayer* m_agentLayer;
+    PointLayer* m_forageLayer;
+    PointLayer* m_crowdingLayer;
+    QVariantAnimation* m_animation;     //moves every agent layer at once
+
+    std::vector<QPointF> m_centers;     //scratch buffers for the layers
+    std::vector<QSizeF> m_radii;
+
+    std::vector<double> m_frameTimes;   //milliseconds spent on each update, since the last report
 
     double m_minX;
     double m_maxX;
     double m_minY;
     double m_maxY;
     bool m_calculatedDataRange;
+    bool m_drawAbsolute;    //no data range: FASO coordinates over the contour map
 
+    void drawData(const Dataset* items);
+    void drawAgents(const SwarmSnapshot& agents);
+    void fitDataRange(const Dataset* items);
+    Projection projection() const;
+    void reportFrameTimes();
 };
 
 #endif // CLUSTERCANVAS_H
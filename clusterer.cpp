@@ -0,0 +1,97 @@
+#include "clusterer.h"
+#include "csvloader.h"
+#include "binarydataset.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+Clusterer::Clusterer(QObject *parent)
+    : QObject(parent)
+{
+    m_iterationsRun = 0;
+    m_dimension = 0;
+    m_parallel = false;
+    m_headless = false;
+    m_seed = 0;
+}
+
+Clusterer::~Clusterer() {
+
+}
+
+/**
+ * @brief Clusterer::loadData Attempts to load the data from the filename given.
+ * @details Binary datasets (see BinaryDataset) are mapped and used in place. Anything else is parsed
+ * as CSV, using the leading numeric columns of every row; see CsvLoader for the details. If a
+ * dimension was set (see setDimension()), only that many leading columns are used.
+ * @param dataSource The filename of the file to load data from.
+ * @return True for successful loading, false if there was an error.
+ */
+bool Clusterer::loadData(std::string dataSource) {
+    m_metrics.reset();
+    ScopedTimer timer(m_metrics, Metrics::Load);
+    if (BinaryDataset::isBinary(dataSource)) {
+        if (!BinaryDataset::load(dataSource, m_data))
+            return false;
+        if (m_dimension >= 2)
+            m_data.truncateDimension(m_dimension);
+        printf("Mapped %i %i-dimensional points from binary dataset\n", m_data.size(), m_data.dimension());
+        return true;
+    }
+
+    CsvLoadStats stats;
+    if (!CsvLoader::load(dataSource, m_data, &stats, m_dimension))
+        return false;
+
+    printf("Parsed %i rows of %i columns (%i skipped) from %.1f MB in %.3f s: %.1f MB/s\n", stats.rows,
+           stats.dimension, stats.skippedRows, stats.bytes / (1024.0 * 1024.0), stats.seconds,
+           stats.megabytesPerSecond());
+    return true;
+}
+
+/**
+ * @brief Clusterer::start Runs the clustering algorithm on the loaded data, and reports the clusters.
+ * @details Whatever the previous run left behind is cleared first, except for the time it took to
+ * load the data.
+ */
+void Clusterer::start() {
+    m_metrics.reset(Metrics::Setup);
+    releaseClusters();
+    m_iterationsRun = 0;
+
+    clusterData();
+
+    emit setClusters(&m_clusters, &m_data);
+    if (!m_metricsFile.empty() && !m_metrics.writeJson(m_metricsFile))
+        printf("Error: unable to write metrics to %s\n", m_metricsFile.c_str());
+    emit finished();
+}
+
+/**
+ * @brief Clusterer::setMetricsFile Enables the metrics (see Metrics), and writes them as JSON to the
+ * given file at the end of every run.
+ */
+void Clusterer::setMetricsFile(const std::string &path) {
+    m_metricsFile = path;
+    m_metrics.setEnabled(true);
+}
+
+/**
+ * @brief Clusterer::createCluster Adds an empty cluster, owned by the arena, with the next id.
+ */
+Cluster* Clusterer::createCluster() {
+    Cluster* cluster = m_arena.create<Cluster>();
+    cluster->id = m_clusters.size();
+    m_clusters.push_back(cluster);
+    return cluster;
+}
+
+/**
+ * @brief Clusterer::releaseClusters Frees the clusters of the previous run in one go, and takes
+ * every data point out of its group. The arena keeps its memory, so back to back runs reuse it.
+ */
+void Clusterer::releaseClusters() {
+    m_clusters.clear();
+    m_arena.release();
+    std::fill(m_data.group.begin(), m_data.group.end(), -1);
+}
@@ -0,0 +1,77 @@
+#ifndef CLUSTERER_H
+#define CLUSTERER_H
+
+#include "def.h"
+#include "arena.h"
+#include "metrics.h"
+
+#include <string>
+#include <QObject>
+#include <QMetaType>
+
+/**
+ * @brief The Clusterer class What every clustering algorithm shares: the dataset and how it is loaded,
+ * the clusters of the latest run and how they are reported, and the run options and metrics.
+ * @details start() clears the previous run, calls clusterData() and reports the clusters through
+ * setClusters(), so AgentCluster and the baselines (KMeans, Dbscan) work on the same input and can be
+ * shown and timed the same way. A run leaves every point's cluster id in Dataset::group, -1 for points
+ * without one.
+ */
+class Clusterer : public QObject
+{
+    Q_OBJECT
+
+public:
+    Clusterer(QObject *parent = 0);
+    virtual ~Clusterer();
+
+    bool loadData(std::string dataSource);
+
+    const Dataset* data() const { return &m_data; }
+    int dataCount() const { return m_data.size(); }
+    int dimension() const { return m_data.dimension(); }
+    int iterationsRun() const { return m_iterationsRun; }
+    int clusterCount() const { return (int)m_clusters.size(); }
+    const Metrics& metrics() const { return m_metrics; }
+
+    void setParallel(bool parallel) { m_parallel = parallel; }
+    void setHeadless(bool headless) { m_headless = headless; }
+    void setSeed(unsigned long long seed) { m_seed = seed; }
+    void setDimension(int dimension) { m_dimension = dimension; }
+    void setMetricsEnabled(bool enabled) { m_metrics.setEnabled(enabled); }
+    void setMetricsFile(const std::string& path);
+
+public slots:
+    void start();
+
+signals:
+    void setClusters(std::vector<Cluster*>* clusters, Dataset* data);
+    void finished();
+
+protected:
+    Dataset m_data;
+    std::vector<Cluster*> m_clusters;   //cluster ids are their index
+    Arena m_arena;                      //owns the clusters of the latest run
+    int m_iterationsRun;
+
+    int m_dimension;    //coordinate columns to use, 0 for all of them
+    bool m_parallel;
+    bool m_headless;    //no per-iteration updates or animation delays
+    unsigned long long m_seed;
+
+    mutable Metrics m_metrics;  //mutable so that const queries can count themselves
+
+    virtual void clusterData() = 0;
+    Cluster* createCluster();
+
+private:
+    std::string m_metricsFile;  //written after every run, if set
+
+    void releaseClusters();
+};
+
+//The clusters are handed to the canvas through a queued connection
+Q_DECLARE_METATYPE(Dataset*)
+Q_DECLARE_METATYPE(std::vector<Cluster*>*)
+
+#endif // CLUSTERER_H
@@ -0,0 +1,69 @@
+#include "convergence.h"
+
+#include <cmath>
+#include <algorithm>
+
+ConvergenceMonitor::ConvergenceMonitor() {
+    reset();
+}
+
+void ConvergenceMonitor::reset() {
+    m_observed = false;
+    m_initialOutcome = 0;
+    m_firstChange = -1;
+    m_convergedAt = -1;
+    m_iterations.clear();
+    m_outcomes.clear();
+}
+
+/**
+ * @brief ConvergenceMonitor::observe Records the outcome of an iteration, and updates the convergence
+ * state. Observations don't have to come every iteration, but they have to come in order.
+ * @param outcome What the run would report if it stopped after this iteration.
+ * @param iteration The iteration that just finished.
+ * @return True if the run has converged.
+ */
+bool ConvergenceMonitor::observe(double outcome, int iteration) {
+    if (converged())
+        return true;
+    if (m_firstChange < 0) {
+        if (!m_observed || outcome == m_initialOutcome) {
+            m_initialOutcome = outcome;
+            m_observed = true;
+            return false;
+        }
+        m_firstChange = iteration;
+    }
+
+    const int patience = m_criteria.patience;
+    m_iterations.push_back(iteration);
+    m_outcomes.push_back(outcome);
+    unsigned int expired = 0;
+    while (expired < m_iterations.size() && m_iterations[expired] <= iteration - 2 * patience)
+        expired++;
+    m_iterations.erase(m_iterations.begin(), m_iterations.begin() + expired);
+    m_outcomes.erase(m_outcomes.begin(), m_outcomes.begin() + expired);
+    if (!isEnabled() || iteration - m_firstChange + 1 < 2 * patience)
+        return false;
+
+    double recent = 0, earlier = 0;
+    int recentCount = 0, earlierCount = 0;
+    for (unsigned int i = 0; i < m_iterations.size(); i++) {
+        if (m_iterations[i] > iteration - patience) {
+            recent += m_outcomes[i];
+            recentCount++;
+        } else {
+            earlier += m_outcomes[i];
+            earlierCount++;
+        }
+    }
+    if (recentCount == 0 || earlierCount == 0)
+        return false;
+    recent /= recentCount;
+    earlier /= earlierCount;
+
+    double larger = std::max(std::fabs(recent), std::fabs(earlier));
+    if (std::fabs(recent - earlier) <= m_criteria.tolerance * larger)
+        m_convergedAt = iteration;
+    return converged();
+}
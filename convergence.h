@@ -0,0 +1,62 @@
+#ifndef CONVERGENCE_H
+#define CONVERGENCE_H
+
+#include "def.h"
+
+#include <vector>
+
+/**
+ * @brief The ConvergenceCriteria struct When a run counts as settled.
+ */
+struct ConvergenceCriteria {
+    int patience;       //length in iterations of the windows that are compared; 0 never stops early
+    double tolerance;   //largest difference between their mean outcomes, relative to the larger one
+
+    ConvergenceCriteria() {
+        patience = CONVERGENCE_PATIENCE;
+        tolerance = CONVERGENCE_TOLERANCE;
+    }
+};
+
+/**
+ * @brief The ConvergenceMonitor class Decides when a run has stopped changing its outcome.
+ * @details Every so often the run hands observe() the outcome it would report if it stopped right
+ * there: the number of clusters for AgentCluster, the mean value under the swarm for FASO. Agents
+ * never quite settle (crowding keeps them moving), so the outcome flickers from one iteration to the
+ * next; the run has converged once the mean outcome over the last criteria().patience iterations is
+ * within the tolerance of the mean over the patience iterations before them.
+ *
+ * The outcome the swarm starts out with, from its random placement, is not a result yet: the windows
+ * only start once the outcome has changed for the first time. A run whose outcome never changes runs
+ * every iteration.
+ *
+ * Working out the outcome can cost the run a pass over the swarm, so it should only call observe()
+ * while isEnabled().
+ */
+class ConvergenceMonitor
+{
+public:
+    ConvergenceMonitor();
+
+    void setCriteria(const ConvergenceCriteria& criteria) { m_criteria = criteria; }
+    const ConvergenceCriteria& criteria() const { return m_criteria; }
+    bool isEnabled() const { return m_criteria.patience > 0; }
+
+    void reset();
+    bool observe(double outcome, int iteration);
+
+    bool converged() const { return m_convergedAt >= 0; }
+    int convergedAt() const { return m_convergedAt; }  //-1 until the run converges
+
+private:
+    ConvergenceCriteria m_criteria;
+    bool m_observed;
+    double m_initialOutcome;
+    int m_firstChange;      //iteration the outcome first differed from the initial one, -1 until it does
+    int m_convergedAt;
+
+    std::vector<int> m_iterations;  //observations since the first change, as far back as both windows reach
+    std::vector<double> m_outcomes;
+};
+
+#endif // CONVERGENCE_H
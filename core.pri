@@ -0,0 +1,48 @@
+#-------------------------------------------------
+#
+# The clustering and optimization code without the GUI, shared by FASO.pro and the benchmarks so
+# that they always build the same sources.
+#
+#-------------------------------------------------
+
+QT       += core concurrent
+CONFIG   += c++17
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/clusterer.cpp \
+    $$PWD/agentcluster.cpp \
+    $$PWD/kmeans.cpp \
+    $$PWD/dbscan.cpp \
+    $$PWD/faso.cpp \
+    $$PWD/spatialgrid.cpp \
+    $$PWD/kdtree.cpp \
+    $$PWD/radiuskernels.cpp \
+    $$PWD/csvloader.cpp \
+    $$PWD/binarydataset.cpp \
+    $$PWD/unionfind.cpp \
+    $$PWD/arena.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/convergence.cpp \
+    $$PWD/snapshotring.cpp
+
+HEADERS += \
+    $$PWD/def.h \
+    $$PWD/dimensions.h \
+    $$PWD/clusterer.h \
+    $$PWD/agentcluster.h \
+    $$PWD/kmeans.h \
+    $$PWD/dbscan.h \
+    $$PWD/faso.h \
+    $$PWD/spatialgrid.h \
+    $$PWD/kdtree.h \
+    $$PWD/parallel.h \
+    $$PWD/radiuskernels.h \
+    $$PWD/csvloader.h \
+    $$PWD/binarydataset.h \
+    $$PWD/unionfind.h \
+    $$PWD/arena.h \
+    $$PWD/metrics.h \
+    $$PWD/convergence.h \
+    $$PWD/snapshotring.h
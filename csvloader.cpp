@@ -0,0 +1,245 @@
+#include "csvloader.h"
+#include "parallel.h"
+
+#include <QFile>
+#include <QElapsedTimer>
+#include <charconv>
+#include <cstring>
+#include <stdio.h>
+
+/**
+ * @brief CsvLoader::load Appends every point in a CSV file to a Dataset.
+ * @param path The filename of the file to load data from.
+ * @param data Dataset to append the points to.
+ * @param stats Optional output for the size, row counts and speed of the load.
+ * @param dimension Number of leading columns that make up a point, or 0 to work it out from the file.
+ * Ignored if the Dataset already has points, which fix the dimension.
+ * @return True for successful loading, false (with an error printed) if the file couldn't be read or
+ * held no points.
+ */
+bool CsvLoader::load(const std::string &path, Dataset &data, CsvLoadStats *stats, int dimension) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(path.c_str());
+    if (!file.open(QFile::ReadOnly)) {
+        printf("Error: unable to open file: %s\n", path.c_str());
+        return false;
+    }
+
+    const long long size = file.size();
+    const char* text = 0;
+    std::vector<char> buffer;   //only used when the file can't be mapped (pipes, some network drives)
+    if (size > 0) {
+        text = (const char*)file.map(0, size);
+        if (!text) {
+            buffer.resize(size);
+            if (file.read(buffer.data(), size) != size) {
+                printf("Error: unable to read file: %s\n", path.c_str());
+                return false;
+            }
+            text = buffer.data();
+        }
+    }
+
+    if (data.size() > 0)
+        dimension = data.dimension();
+    else if (dimension <= 0)
+        dimension = detectDimension(text, text + size);
+    dimension = std::min(std::max(dimension, 2), MAX_DIMENSIONS);
+
+    //Cut the file into chunks that end right after a newline. The cuts only depend on the file,
+    //so the result is the same for any number of threads.
+    std::vector<Chunk> chunks;
+    const char* position = text;
+    const char* fileEnd = text + size;
+    while (position < fileEnd) {
+        const char* end = position + std::min<long long>(CSV_CHUNK_BYTES, fileEnd - position);
+        if (end < fileEnd) {
+            const char* newline = (const char*)memchr(end, '\n', fileEnd - end);
+            end = newline ? newline + 1 : fileEnd;
+        }
+        Chunk chunk;
+        chunk.begin = position;
+        chunk.end = end;
+        chunk.offset = chunk.lines = chunk.parsed = chunk.skipped = 0;
+        chunks.push_back(chunk);
+        position = end;
+    }
+
+    //Count the lines of every chunk, which bounds how many points it can produce.
+    parallelFor((int)chunks.size(), 1, [&chunks](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            Chunk& chunk = chunks[i];
+            for (const char* c = chunk.begin; c < chunk.end; c++) {
+                c = (const char*)memchr(c, '\n', chunk.end - c);
+                if (!c)
+                    break;
+                chunk.lines++;
+            }
+            if (chunk.end > chunk.begin && chunk.end[-1] != '\n')
+                chunk.lines++;  //last line of the file, without a newline
+        }
+    });
+
+    data.detach();
+    data.owned.resize(dimension);
+    const int first = data.size();
+    int capacity = first;
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+        chunks[i].offset = capacity;
+        capacity += chunks[i].lines;
+    }
+    std::vector<double*> columns(dimension);
+    for (int d = 0; d < dimension; d++) {
+        data.owned[d].resize(capacity);
+        columns[d] = data.owned[d].data();
+    }
+
+    double* const* output = columns.data();
+    parallelFor((int)chunks.size(), 1, [&chunks, output, dimension](int begin, int end) {
+        for (int i = begin; i < end; i++)
+            parseChunk(chunks[i], output, dimension);
+    });
+
+    //Close the gaps left by skipped lines, keeping the file order.
+    int rows = first;
+    int skipped = 0;
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+        const Chunk& chunk = chunks[i];
+        if (chunk.offset != rows) {
+            for (int d = 0; d < dimension; d++)
+                memmove(columns[d] + rows, columns[d] + chunk.offset, chunk.parsed * sizeof(double));
+        }
+        rows += chunk.parsed;
+        skipped += chunk.skipped;
+    }
+    for (int d = 0; d < dimension; d++)
+        data.owned[d].resize(rows);
+    data.attach();
+
+    if (size > 0 && buffer.empty())
+        file.unmap((uchar*)text);
+    file.close();
+
+    if (rows == first) {    //nothing to cluster; the solvers need at least one point
+        printf("Error: no points in %s\n", path.c_str());
+        return false;
+    }
+
+    if (stats) {
+        stats->bytes = size;
+        stats->rows = rows - first;
+        stats->skippedRows = skipped;
+        stats->dimension = dimension;
+        stats->seconds = timer.nsecsElapsed() / 1e9;
+    }
+    return true;
+}
+
+/**
+ * @brief CsvLoader::detectDimension Counts the leading numeric columns of the first line that has at
+ * least two of them.
+ * @return The count, or 0 if no line qualifies.
+ */
+int CsvLoader::detectDimension(const char *begin, const char *end) {
+    const char* line = begin;
+    while (line < end) {
+        const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+        if (!lineEnd)
+            lineEnd = end;
+        int fields = numericFields(line, lineEnd);
+        if (fields >= 2)
+            return fields;
+        line = lineEnd + 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief CsvLoader::parseChunk Parses every line of a chunk into the chunk's slice of the output
+ * columns, packed at the front of the slice.
+ */
+void CsvLoader::parseChunk(Chunk &chunk, double* const* columns, int dimension) {
+    const char* line = chunk.begin;
+    while (line < chunk.end) {
+        const char* lineEnd = (const char*)memchr(line, '\n', chunk.end - line);
+        if (!lineEnd)
+            lineEnd = chunk.end;
+
+        double values[MAX_DIMENSIONS];
+        if (parseLine(line, lineEnd, dimension, values)) {
+            for (int d = 0; d < dimension; d++)
+                columns[d][chunk.offset + chunk.parsed] = values[d];
+            chunk.parsed++;
+        } else {
+            const char* c = line;
+            while (c < lineEnd && (*c == ' ' || *c == '\t' || *c == '\r'))
+                c++;
+            if (c < lineEnd)    //blank lines aren't worth reporting
+                chunk.skipped++;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+/**
+ * @brief CsvLoader::parseLine Reads the first dimension columns of a line as numbers.
+ * @return False if the line doesn't start with that many numeric columns.
+ */
+bool CsvLoader::parseLine(const char *begin, const char *end, int dimension, double *values) {
+    const char* next = begin;
+    for (int d = 0; d < dimension; d++) {
+        if (d > 0) {
+            if (next == end)
+                return false;
+            next++;     //past the comma
+        }
+        next = parseField(next, end, values[d]);
+        if (!next)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief CsvLoader::numericFields Counts the numeric columns a line starts with, up to MAX_DIMENSIONS.
+ */
+int CsvLoader::numericFields(const char *begin, const char *end) {
+    double value;
+    const char* next = begin;
+    int fields = 0;
+    while (fields < MAX_DIMENSIONS) {
+        next = parseField(next, end, value);
+        if (!next)
+            break;
+        fields++;
+        if (next == end)
+            break;
+        next++;
+    }
+    return fields;
+}
+
+/**
+ * @brief CsvLoader::parseField Parses one numeric column, allowing surrounding whitespace (and a
+ * trailing carriage return).
+ * @return Pointer to the separator or line end after the field, or 0 if it isn't a number.
+ */
+const char* CsvLoader::parseField(const char *begin, const char *end, double &value) {
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        begin++;
+    if (begin < end && *begin == '+')   //from_chars only takes a leading minus
+        begin++;
+
+    std::from_chars_result result = std::from_chars(begin, end, value);
+    if (result.ec != std::errc())
+        return 0;
+
+    const char* c = result.ptr;
+    while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+        c++;
+    if (c < end && *c != ',')
+        return 0;
+    return c;
+}
@@ -0,0 +1,66 @@
+#ifndef CSVLOADER_H
+#define CSVLOADER_H
+
+#include "def.h"
+
+#include <string>
+
+/**
+ * @brief The CsvLoadStats struct What a CSV load did, and how fast.
+ */
+struct CsvLoadStats {
+    long long bytes;
+    int rows;           //rows parsed into points
+    int skippedRows;    //non-empty rows without enough leading numbers (headers, comments...)
+    int dimension;      //coordinate columns read from every row
+    double seconds;
+
+    CsvLoadStats() {
+        bytes = 0;
+        rows = 0;
+        skippedRows = 0;
+        dimension = 0;
+        seconds = 0;
+    }
+
+    double megabytesPerSecond() const {
+        return (seconds > 0) ? ((double)bytes / (1024.0 * 1024.0)) / seconds : 0;
+    }
+};
+
+/**
+ * @brief The CsvLoader class Loads points from comma-separated files.
+ * @details The file is memory mapped and cut into newline-aligned chunks of about CSV_CHUNK_BYTES. The
+ * chunks are parsed in parallel with std::from_chars, straight into the Dataset's owned coordinates:
+ * a first pass counts the lines of every chunk, which gives each chunk its own slice of the arrays,
+ * and a final pass closes the gaps left by skipped lines.
+ *
+ * Every line contributes its first dimension columns as one point; any further columns are ignored.
+ * Unless the dimension is given (or the Dataset already has points), it is the number of leading
+ * numeric columns on the first line that has at least two. Lines that don't start with dimension
+ * numbers (such as a header) are skipped, as are blank lines. A file without a single point fails to
+ * load.
+ */
+class CsvLoader
+{
+public:
+    static bool load(const std::string& path, Dataset& data, CsvLoadStats* stats = 0, int dimension = 0);
+
+private:
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        int offset;     //first row of the chunk in the output arrays
+        int lines;
+        int parsed;
+        int skipped;
+    };
+
+    static int detectDimension(const char* begin, const char* end);
+    static void parseChunk(Chunk& chunk, double* const* columns, int dimension);
+    static bool parseLine(const char* begin, const char* end, int dimension, double* values);
+    static int numericFields(const char* begin, const char* end);
+    static const char* parseField(const char* begin, const char* end, double& value);
+};
+
+#endif // CSVLOADER_H
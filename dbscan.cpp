@@ -0,0 +1,185 @@
+#include "dbscan.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+Dbscan::Dbscan(double eps, int minPoints, QObject *parent)
+    : Clusterer(parent)
+{
+    m_eps = eps;
+    m_minPoints = minPoints;
+    m_noise = 0;
+}
+
+/**
+ * @brief Dbscan::clusterData Runs DBSCAN, specialized for the dimension of the data if possible.
+ */
+void Dbscan::clusterData() {
+    switch (m_data.dimension()) {
+#define RUN_DIMENSION(D) case D: run<D>(); break;
+    SPECIALIZED_DIMENSIONS(RUN_DIMENSION)
+#undef RUN_DIMENSION
+    default:
+        run<0>();
+        break;
+    }
+}
+
+/**
+ * @brief Dbscan::run Indexes the data, finds and links the core points, and labels every point.
+ */
+template <int D>
+void Dbscan::run() {
+    printf("Running DBSCAN (eps %g, min points %i) on %i-dimensional data...\n", m_eps, m_minPoints,
+           m_data.dimension());
+    m_noise = 0;
+    if (m_data.size() == 0 || m_eps <= 0)
+        return;
+
+    {
+        ScopedTimer timer(m_metrics, Metrics::Setup);
+        double minX = m_data.x[0], maxX = m_data.x[0];
+        double minY = m_data.y[0], maxY = m_data.y[0];
+        for (int i = 1; i < m_data.size(); i++) {
+            minX = std::min(minX, m_data.x[i]);
+            maxX = std::max(maxX, m_data.x[i]);
+            minY = std::min(minY, m_data.y[i]);
+            maxY = std::max(maxY, m_data.y[i]);
+        }
+        m_grid.build(m_data.columnData(), m_data.dimension(), m_data.size(), m_eps, minX, minY, maxX, maxY);
+    }
+
+    {
+        ScopedTimer timer(m_metrics, Metrics::Convergence);
+        findCorePoints<D>();
+        linkCorePoints<D>();
+    }
+
+    ScopedTimer timer(m_metrics, Metrics::Assignment);
+    anchorBorderPoints<D>();
+    buildClusters();
+    printf("DBSCAN found %i clusters and %i noise points\n", clusterCount(), m_noise);
+}
+
+/**
+ * @brief Dbscan::findCorePoints Flags every point with at least m_minPoints points within eps,
+ * counting itself.
+ */
+template <int D>
+void Dbscan::findCorePoints() {
+    m_core.assign(m_data.size(), 0);
+    forEachPoint([this](int i) {
+        double position[PointCapacity<D>::value];
+        pointPosition<D>(i, position);
+        int neighbors = m_grid.count<D>(position, m_eps);
+        m_core[i] = (neighbors >= m_minPoints);
+        m_metrics.count(Metrics::NeighborQueries);
+        m_metrics.count(Metrics::PointsFound, neighbors);
+    });
+}
+
+/**
+ * @brief Dbscan::linkCorePoints Merges every core point with the core points within eps of it in
+ * m_links, leaving one set per cluster. Each pair is merged once, by its higher index.
+ */
+template <int D>
+void Dbscan::linkCorePoints() {
+    m_links.reset(m_data.size());
+    forEachPoint([this](int i) {
+        if (!m_core[i])
+            return;
+        double position[PointCapacity<D>::value];
+        pointPosition<D>(i, position);
+        int found = 0;
+        m_grid.visit<D>(position, m_eps, i, [this, i, &found](int other, double) {
+            found++;
+            if (other < i && m_core[other])
+                m_links.unite(i, other);
+        });
+        m_metrics.count(Metrics::NeighborQueries);
+        m_metrics.count(Metrics::PointsFound, found);
+    });
+}
+
+/**
+ * @brief Dbscan::anchorBorderPoints Works out which core point every point belongs with: core points
+ * with themselves, the others with their closest core point within eps (the lowest index on a tie),
+ * or none.
+ * @details Plain DBSCAN gives a border point to whichever cluster reaches it first, which depends on
+ * the order the clusters are expanded in; the closest core point doesn't.
+ */
+template <int D>
+void Dbscan::anchorBorderPoints() {
+    m_anchor.assign(m_data.size(), -1);
+    forEachPoint([this](int i) {
+        if (m_core[i]) {
+            m_anchor[i] = i;
+            return;
+        }
+        double position[PointCapacity<D>::value];
+        pointPosition<D>(i, position);
+        int anchor = -1;
+        double anchorDistance = 0;
+        int found = 0;
+        m_grid.visit<D>(position, m_eps, i, [&](int other, double distanceSquared) {
+            found++;
+            if (!m_core[other])
+                return;
+            if (anchor < 0 || distanceSquared < anchorDistance
+                    || (distanceSquared == anchorDistance && other < anchor)) {
+                anchor = other;
+                anchorDistance = distanceSquared;
+            }
+        });
+        m_anchor[i] = anchor;
+        m_metrics.count(Metrics::NeighborQueries);
+        m_metrics.count(Metrics::PointsFound, found);
+    });
+}
+
+/**
+ * @brief Dbscan::buildClusters Turns the sets of linked core points into clusters, numbered in order
+ * of their lowest point, and adds every anchored point to its core point's cluster.
+ */
+void Dbscan::buildClusters() {
+    std::vector<int> setCluster(m_data.size(), -1);
+    for (int i = 0; i < m_data.size(); i++) {
+        if (m_anchor[i] < 0) {
+            m_noise++;
+            continue;
+        }
+        int root = m_links.find(m_anchor[i]);
+        if (setCluster[root] == -1)
+            setCluster[root] = createCluster()->id;
+        m_data.group[i] = setCluster[root];
+        m_clusters[setCluster[root]]->points.push_back(i);
+    }
+}
+
+/**
+ * @brief Dbscan::forEachPoint Calls body(point) for every point. Runs on the thread pool in parallel
+ * mode, so body may only write to the point it was given.
+ */
+template <typename Function>
+void Dbscan::forEachPoint(Function body) {
+    if (!m_parallel) {
+        for (int i = 0; i < m_data.size(); i++)
+            body(i);
+        return;
+    }
+    parallelFor(m_data.size(), POINT_CHUNK_SIZE, [&body](int begin, int end) {
+        for (int i = begin; i < end; i++)
+            body(i);
+    });
+}
+
+/**
+ * @brief Dbscan::pointPosition Copies the coordinates of a point out of the data columns.
+ */
+template <int D>
+void Dbscan::pointPosition(int index, double *position) const {
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    for (int d = 0; d < dimension; d++)
+        position[d] = m_data.columns[d][index];
+}
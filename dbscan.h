@@ -0,0 +1,56 @@
+#ifndef DBSCAN_H
+#define DBSCAN_H
+
+#include "clusterer.h"
+#include "spatialgrid.h"
+#include "unionfind.h"
+
+#include <vector>
+
+/**
+ * @brief The Dbscan class DBSCAN over a uniform grid, as a baseline to time AgentCluster against on
+ * the same data and hardware.
+ * @details A point with at least minPoints points (itself included) within eps is a core point. Core
+ * points within eps of one another end up in the same cluster, found with the lock-free UnionFind,
+ * so the clusters don't depend on the order the points are processed in. Every other point joins the
+ * cluster of its closest core point within eps, or is left as noise (group -1, in no cluster).
+ * All neighbor lookups go through a SpatialGrid with eps sized cells.
+ *
+ * In parallel mode every step runs on the thread pool, with the same result. In the metrics, setup
+ * is building the grid, convergence finding and linking the core points, and assignment labelling
+ * every point.
+ */
+class Dbscan : public Clusterer
+{
+    Q_OBJECT
+
+public:
+    Dbscan(double eps, int minPoints, QObject *parent = 0);
+
+    int noiseCount() const { return m_noise; }
+
+protected:
+    void clusterData();
+
+private:
+    double m_eps;
+    int m_minPoints;
+    int m_noise;
+
+    SpatialGrid m_grid;
+    UnionFind m_links;          //connected core points
+    std::vector<char> m_core;
+    std::vector<int> m_anchor;  //per point: the core point it belongs with, or -1 for noise
+
+    template <int D> void run();
+    template <int D> void findCorePoints();
+    template <int D> void linkCorePoints();
+    template <int D> void anchorBorderPoints();
+    void buildClusters();
+
+    template <typename Function>
+    void forEachPoint(Function body);
+    template <int D> void pointPosition(int index, double* position) const;
+};
+
+#endif // DBSCAN_H
@@ -2,63 +2,309 @@
 #define DEF_H
 
 #include <vector>
+#include <memory>
 #include <sstream>
 #include <stdlib.h>
 #include <cmath>
+#include <algorithm>
+
+#include "dimensions.h"
 
 #define E 2.718281828459
 #define PI 3.14159265
 
 /**
- * @brief The ClusterItem struct Simple structure for holding values pertinent to inputted data.
+ * @brief The Dataset struct Structure-of-arrays storage for inputted data. Data point i is made up of
+ * the i-th entry of each column, so loops that only need positions stream through the coordinates alone.
+ * @details A dataset has one coordinate column per dimension (at least two); x and y are shorthand for
+ * the first two, which are the ones that get drawn. The columns are read through plain pointers, which
+ * either point at the owned vectors below or straight into a memory mapped file (see BinaryDataset). A
+ * mapped dataset keeps its file mapped for as long as it lives. group holds the cluster each point gets
+ * assigned to.
  */
-struct ClusterItem {
-    int group;
-    double x;
-    double y;
+struct Dataset {
+    const double* x;
+    const double* y;
+    std::vector<const double*> columns;
+    std::vector<int> group;
+
+    std::vector<std::vector<double> > owned;
+    std::shared_ptr<const void> mapping;
+
+    Dataset() {
+        x = y = 0;
+        m_count = 0;
+    }
+
+    int size() const { return m_count; }
+    int dimension() const { return (int)columns.size(); }
+    const double* const* columnData() const { return columns.data(); }
+
+    /**
+     * @brief append Adds a point to a 2-dimensional dataset.
+     */
+    void append(double px, double py) {
+        detach();
+        if (owned.empty())
+            owned.resize(2);
+        owned[0].push_back(px);
+        owned[1].push_back(py);
+        attach();
+    }
+
+    /**
+     * @brief detach Makes the owned columns hold the coordinates so they can be edited, copying them out
+     * of a mapped file if necessary.
+     */
+    void detach() {
+        if (mapping) {
+            owned.resize(columns.size());
+            for (unsigned int d = 0; d < columns.size(); d++)
+                owned[d].assign(columns[d], columns[d] + m_count);
+            mapping.reset();
+        }
+    }
+
+    /**
+     * @brief attach Points the dataset at the owned columns again, after they were edited.
+     */
+    void attach() {
+        columns.resize(owned.size());
+        for (unsigned int d = 0; d < owned.size(); d++)
+            columns[d] = owned[d].data();
+        m_count = owned.empty() ? 0 : (int)owned[0].size();
+        pointAtColumns();
+        group.resize(m_count, -1);
+    }
+
+    /**
+     * @brief attachMapped Points the dataset at columns that live in mapped memory.
+     * @param owner Keeps the mapping alive; released when the dataset is destroyed or edited.
+     */
+    void attachMapped(const std::vector<const double*>& coordinateColumns, int count,
+                      std::shared_ptr<const void> owner) {
+        owned.clear();
+        columns = coordinateColumns;
+        m_count = count;
+        mapping = owner;
+        pointAtColumns();
+        group.assign(count, -1);
+    }
 
-    ClusterItem() {
-        group = -1;
-        x = 0;
-        y = 0;
+    /**
+     * @brief truncateDimension Keeps only the first dimension columns. Nothing is copied.
+     */
+    void truncateDimension(int dimension) {
+        if (dimension >= (int)columns.size())
+            return;
+        columns.resize(dimension);
+        if (owned.size() > columns.size())
+            owned.resize(columns.size());
+        pointAtColumns();
     }
+
+private:
+    int m_count;
+
+    void pointAtColumns() {
+        x = (columns.size() > 0) ? columns[0] : 0;
+        y = (columns.size() > 1) ? columns[1] : 0;
+    }
+
+    //The columns may point into this object's own vectors.
+    Dataset(const Dataset&);
+    Dataset& operator=(const Dataset&);
 };
 
 /**
- * @brief The Agent struct Contains data representing a single agent.
+ * @brief The Swarm struct Structure-of-arrays storage for a population of agents. Agent i is made up
+ * of the i-th entry of each array.
+ * @details Agents live in as many dimensions as the data they search. x and y are the first two
+ * coordinates (the ones that get drawn); any further ones are kept in extra, one array per dimension.
  */
-struct Agent {
-    double x;
-    double y;
+struct Swarm {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<std::vector<double> > extra;
 
-    double happiness;
+    std::vector<double> happiness;
 
-    double foragingRange;
-    double crowdingRange;
-    double selectionRange;
+    std::vector<double> foragingRange;
+    std::vector<double> crowdingRange;
 
-    bool visited;
-    int cluster;
+    std::vector<char> visited;
+    std::vector<int> cluster;
 
-    Agent() {
-        x = y = 0;
-        cluster = -1;
-        happiness = 0.0;
-        foragingRange = selectionRange = crowdingRange = 0.0;
-        visited = false;
+    int size() const { return (int)x.size(); }
+    int dimension() const { return 2 + (int)extra.size(); }
+
+    std::vector<double>& column(int d) { return (d == 0) ? x : ((d == 1) ? y : extra[d - 2]); }
+    const std::vector<double>& column(int d) const { return (d == 0) ? x : ((d == 1) ? y : extra[d - 2]); }
+
+    /**
+     * @brief setDimension Adds or drops coordinate arrays. Agents start at 0 in any new dimension.
+     */
+    void setDimension(int dimension) {
+        extra.resize(std::max(dimension - 2, 0), std::vector<double>(size(), 0.0));
+    }
+
+    /**
+     * @brief resize Grows or shrinks the swarm. New agents start at the origin with no happiness,
+     * no range and no cluster.
+     */
+    void resize(int count) {
+        x.resize(count, 0.0);
+        y.resize(count, 0.0);
+        for (unsigned int d = 0; d < extra.size(); d++)
+            extra[d].resize(count, 0.0);
+        happiness.resize(count, 0.0);
+        foragingRange.resize(count, 0.0);
+        crowdingRange.resize(count, 0.0);
+        visited.resize(count, false);
+        cluster.resize(count, -1);
+    }
+
+    /**
+     * @brief compact Drops every agent whose keep flag is false in a single stable pass. Surviving
+     * agents keep their relative order, but move to lower indices.
+     * @param keep One flag per agent.
+     */
+    void compact(const std::vector<char>& keep) {
+        int kept = 0;
+        for (int i = 0; i < size(); i++) {
+            if (!keep[i])
+                continue;
+            x[kept] = x[i];
+            y[kept] = y[i];
+            for (unsigned int d = 0; d < extra.size(); d++)
+                extra[d][kept] = extra[d][i];
+            happiness[kept] = happiness[i];
+            foragingRange[kept] = foragingRange[i];
+            crowdingRange[kept] = crowdingRange[i];
+            visited[kept] = visited[i];
+            cluster[kept] = cluster[i];
+            kept++;
+        }
+        resize(kept);
     }
 };
 
+/**
+ * @brief The Cluster struct A group of agents, and the data points assigned to it. Agents and points
+ * are stored as indices into the Swarm and Dataset they came from.
+ */
 struct Cluster {
     int id;
-    std::vector<Agent*> agents;
-    std::vector<ClusterItem*> points;
+    std::vector<int> agents;
+    std::vector<int> points;
 
     Cluster() {
         id = 0;
     }
 };
 
+/**
+ * @brief The RandomStreamKind enum What a RandomStream is used for. Part of the stream's counter, so
+ * draws for different purposes never overlap.
+ */
+enum RandomStreamKind {
+    RandomMoves,
+    RandomPlacement,
+    RandomSampling,
+    RandomSeeding,      //k-means++ centroid picks
+    RANDOM_STREAM_KINDS
+};
+
+/**
+ * @brief The RandomStream struct Counter-based random numbers (Philox-4x32-10).
+ * @details Every block of output is a pure function of the seed and a 128-bit counter made up of
+ * (stream, iteration, agent, draw). There is no shared state to lock or advance, so any agent's
+ * draws in any iteration come out the same no matter which thread makes them, or in what order.
+ * Streams are cheap to create: one per agent per iteration is the intended use.
+ */
+struct RandomStream {
+    unsigned int key[2];
+    unsigned int counter[4];
+    unsigned int block[4];
+    int used;   //words of the current block already handed out
+
+    RandomStream(unsigned long long seed, unsigned int iteration, unsigned int agent,
+                 unsigned int stream = RandomMoves) {
+        key[0] = (unsigned int)seed;
+        key[1] = (unsigned int)(seed >> 32);
+        counter[0] = 0;
+        counter[1] = agent;
+        counter[2] = iteration;
+        counter[3] = stream;
+        used = 4;
+    }
+
+    /**
+     * @brief next Generates 64 random bits.
+     */
+    unsigned long long next() {
+        if (used == 4) {
+            generateBlock();
+            used = 0;
+        }
+        unsigned long long bits = ((unsigned long long)block[used] << 32) | block[used + 1];
+        used += 2;
+        return bits;
+    }
+
+    /**
+     * @brief uniform Generates a random double within [min, max).
+     */
+    double uniform(double min, double max) {
+        double f = (double)(next() >> 11) * (1.0 / 9007199254740992.0);
+        return min + f * (max - min);
+    }
+
+    /**
+     * @brief below Generates a random integer within [0, bound).
+     */
+    int below(int bound) {
+        return (int)((double)(next() >> 11) * (1.0 / 9007199254740992.0) * bound);
+    }
+
+    /**
+     * @brief normal Generates a standard normally distributed double (Box-Muller, one draw per value).
+     */
+    double normal() {
+        double u = uniform(0, 1);
+        double v = uniform(0, 1);
+        return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * 3.14159265358979323846 * v);
+    }
+
+private:
+    void generateBlock() {
+        unsigned int c[4] = { counter[0], counter[1], counter[2], counter[3] };
+        unsigned int k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            unsigned long long p0 = (unsigned long long)0xD2511F53u * c[0];
+            unsigned long long p1 = (unsigned long long)0xCD9E8D57u * c[2];
+            unsigned int next0 = (unsigned int)(p1 >> 32) ^ c[1] ^ k0;
+            unsigned int next2 = (unsigned int)(p0 >> 32) ^ c[3] ^ k1;
+            c[1] = (unsigned int)p1;
+            c[3] = (unsigned int)p0;
+            c[0] = next0;
+            c[2] = next2;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        for (int i = 0; i < 4; i++)
+            block[i] = c[i];
+        counter[0]++;
+    }
+};
+
+/**
+ * @brief randomStreamId Stream number for one kind of draw within one of several independent runs
+ * (such as FASO instances) that share a seed.
+ */
+inline unsigned int randomStreamId(int run, RandomStreamKind kind) {
+    return (unsigned int)run * RANDOM_STREAM_KINDS + kind;
+}
 
 //Configuration parameters
 
@@ -72,6 +318,51 @@ static const double SWARM_SIZE_FACTOR = 0.6;
  */
 static const double SENSOR_TO_AVG_DIST_RATIO  = 0.4;
 
+/* The relative error allowed (at 95% confidence) when estimating the average datapoint-to-datapoint
+ * distance from sampled pairs of points.
+ */
+static const double AVG_DIST_SAMPLE_ERROR = 0.01;
+
+/* Bounds on the number of point pairs sampled for the average distance estimate. Datasets with fewer
+ * pairs than the upper bound just get the exact average.
+ */
+static const int AVG_DIST_MIN_SAMPLES = 4096;
+static const int AVG_DIST_MAX_SAMPLES = 1000000;
+static const int AVG_DIST_SAMPLE_BATCH = 1024;
+
+/* Side length, in points, of the cache tiles used for the exact average distance.
+ */
+static const int AVG_DIST_TILE_SIZE = 512;
+
+/* Approximate size of the chunks CSV files are split into for parallel parsing.
+ */
+static const int CSV_CHUNK_BYTES = 1 << 20;
+
+/* Version of the binary dataset format written by BinaryDataset, and the byte boundary its columns are
+ * aligned to (a cache line).
+ */
+static const unsigned int BINARY_DATASET_VERSION = 1;
+static const int BINARY_COLUMN_ALIGNMENT = 64;
+
+/* Number of agents handed to each thread pool task by the parallel agent updates.
+ */
+static const int AGENT_CHUNK_SIZE = 64;
+
+/* Number of data points handed to each thread pool task when unclaimed points are assigned to
+ * their closest agent.
+ */
+static const int POINT_CHUNK_SIZE = 1024;
+
+/* Default convergence criteria (see ConvergenceMonitor): a run stops once its mean outcome over the
+ * last 25 iterations is within 10% of the mean over the 25 before. On the bundled sets this stops
+ * most FASC runs after 60-95 of 100 iterations, with the same cluster counts as full runs within
+ * run-to-run noise. FASC only counts its clusters every few iterations, since a count costs about as
+ * much as an iteration.
+ */
+static const int CONVERGENCE_PATIENCE = 25;
+static const double CONVERGENCE_TOLERANCE = 0.1;
+static const int CONVERGENCE_CHECK_INTERVAL = 5;
+
 /* The ratio of the crowding range to the foraging range.
  */
 static const double CROWDING_TO_FORAGE_DIST_RATIO = 0.4;
@@ -134,18 +425,6 @@ static std::vector<std::string> split(const std::string &s, char delim) {
     return elems;
 }
 
-/**
- * @brief randomDouble Generates a random double within a given range.
- * @param min The bottom of the range.
- * @param max The top of the range.
- * @return The random double.
- */
-static double randomDouble(double min, double max) {
-    double f = (double)rand() / RAND_MAX;
-    return min + f * (max - min);
-}
-
-
 /**
  * @brief pointDistance Euclidean distance between two points.
  * @param x1 X position of object 1
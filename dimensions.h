@@ -0,0 +1,74 @@
+#ifndef DIMENSIONS_H
+#define DIMENSIONS_H
+
+/**
+ * Helpers for code that is specialized on the number of dimensions at compile time.
+ *
+ * Code templated on an int D handles D-dimensional points; D == 0 is the generic version, which takes
+ * the dimension at runtime instead. Loops bounded by dimensionCount<D>() have a constant trip count in
+ * the specialized versions, so the compiler unrolls them and keeps the coordinates in registers.
+ *
+ * SPECIALIZED_DIMENSIONS lists the dimensions that get their own versions. It is used both to
+ * explicitly instantiate the templates and to pick one at runtime, so the two can't drift apart:
+ *
+ *      #define INSTANTIATE(D) template int KdTree::countWithinRadius<D>(...) const;
+ *      SPECIALIZED_DIMENSIONS(INSTANTIATE)
+ */
+
+#define SPECIALIZED_DIMENSIONS(X) X(2) X(3) X(4) X(8) X(16)
+
+static const int MAX_DIMENSIONS = 64;   //enough for stack buffers holding one point
+
+template <int D>
+inline int dimensionCount(int runtimeDimension) {
+    return (D > 0) ? D : runtimeDimension;
+}
+
+/**
+ * @brief The PointCapacity struct Size of a stack buffer that holds one point: exactly D coordinates
+ * in the specialized versions, MAX_DIMENSIONS in the generic one.
+ */
+template <int D>
+struct PointCapacity {
+    static const int value = (D > 0) ? D : MAX_DIMENSIONS;
+};
+
+/**
+ * @brief pointDistanceSquared Squared Euclidean distance between two points.
+ */
+template <int D>
+inline double pointDistanceSquared(const double* a, const double* b, int dimension) {
+    const int dimensions = dimensionCount<D>(dimension);
+    double sum = 0;
+    for (int d = 0; d < dimensions; d++) {
+        double delta = b[d] - a[d];
+        sum += delta * delta;
+    }
+    return sum;
+}
+
+/**
+ * @brief isSpecializedDimension Whether a dimension has its own compile-time version.
+ */
+inline bool isSpecializedDimension(int dimension) {
+#define MATCH_DIMENSION(D) if (dimension == D) return true;
+    SPECIALIZED_DIMENSIONS(MATCH_DIMENSION)
+#undef MATCH_DIMENSION
+    return false;
+}
+
+/**
+ * @brief columnDistanceSquared Squared distance from a point to entry index of a set of columns.
+ */
+template <int D>
+inline double columnDistanceSquared(const double* point, const double* const* columns, int index, int dimension) {
+    const int dimensions = dimensionCount<D>(dimension);
+    double sum = 0;
+    for (int d = 0; d < dimensions; d++) {
+        double delta = columns[d][index] - point[d];
+        sum += delta * delta;
+    }
+    return sum;
+}
+
+#endif // DIMENSIONS_H
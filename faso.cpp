@@ -1,5 +1,6 @@
 #include "faso.h"
 #include "def.h"
+#include "parallel.h"
 
 #include <QMutex>
 #include <QFile>
@@ -22,8 +23,10 @@ FASO::FASO(int iterations,
     m_testFunction = selectedFunction;
     m_iterations = iterations;
     m_swarmSize = swarmSize;
-    m_lowestValue = landscape(0, 0);
     m_instances = instances;
+    m_headless = false;
+    m_seed = 0;
+    m_resultsFile = "../AgentCluster/test_data/results.csv";
 }
 FASO::~FASO() {
 }
@@ -45,47 +48,45 @@ void FASO::start() {
     double* xPositions = (double*) calloc(m_swarmSize * m_instances, sizeof(double));
     double* yPositions = (double*) calloc(m_swarmSize * m_instances, sizeof(double));
 
-
-    for (int i = 0; i < m_swarmSize; i++) { //create the swarm...
-        Agent* agent = new Agent();
-        agent->x = randomDouble(m_dataMinX, m_dataMaxX);
-        agent->y = randomDouble(m_dataMinY, m_dataMaxY);
-        m_agents.push_back(agent);
+    m_swarms.clear();
+    m_swarms.reserve(m_instances);
+    for (int n = 0; n < m_instances; n++)
+        m_swarms.push_back(Instance(n, landscape(0, 0)));
+    printf("Running %i instances of a swarm containing %i agents...\n", m_instances, m_swarmSize);
+
+    //Instance 0 is the one shown and paced, so it runs on this thread rather than holding a pool
+    //worker while it waits; the others share the pool in the meantime.
+    QFuture<void> others;
+    if (m_instances > 1) {
+        others = QtConcurrent::run([&]() {
+            parallelFor(m_instances - 1, 1, [&](int begin, int end) {
+                for (int n = begin + 1; n < end + 1; n++)
+                    runInstance(m_swarms[n], xPositions, yPositions);
+            });
+        });
     }
-    printf("Created a swarm containing %i agents...\n", m_swarmSize);
+    runInstance(m_swarms[0], xPositions, yPositions);
+    others.waitForFinished();
 
-    for (int n = 0; n < m_instances; n++) {
+    if (!m_resultsFile.empty())
+        writeResults(xPositions, yPositions);
 
+    free(xPositions);
+    free(yPositions);
+    printf("\n\nFinished...\n");
+    emit finished();
+}
 
-        for (int i = 0; i < m_iterations; i++) {
-            updateHappiness();
-            updateRanges();
-            for (unsigned int j = 0; j < m_agents.size(); j++) {
-                Agent* agent= m_agents[j];
-                move(agent);
-            }
 
-            printf("Finished iteration %i...\n", i);
-            if (i % UPDATE_RATE == 0) {
-                emit update(&m_agents);
-                printf("\tupdating...");
-            }
-            sleep(MOVEMENT_DELAY);
-        }
 
-        for (unsigned int i = 0; i < m_agents.size(); i++) { //save positions...
-            Agent *a = m_agents[i];
-            int index = (n * m_agents.size()) + i;
-            xPositions[index] = a->x;
-            yPositions[index] = a->y;
-            a->x = randomDouble(m_dataMinX, m_dataMaxX);
-            a->y = randomDouble(m_dataMinY, m_dataMaxY);
-        }
 
-        printf("Finished instance %i\n", n);
-    }
 
-    QFile file("../AgentCluster/test_data/results.csv");
+/**
+ * @brief FASO::writeResults Writes the final position of every agent of every instance to the results
+ * file, one x,y line each, or prints them if the file can't be opened.
+ */
+void FASO::writeResults(const double *xPositions, const double *yPositions) {
+    QFile file(m_resultsFile.c_str());
     if (file.open(QFile::WriteOnly | QFile::Truncate)) {
         QTextStream stream(&file);
         for (int i = 0; i < (m_swarmSize * m_instances); i++) {
@@ -97,79 +98,192 @@ void FASO::start() {
         for (int i = 0; i < (m_swarmSize * m_instances); i++)
             printf("%4.2f,%4.2f\n", xPositions[i], yPositions[i]);
     }
+}
 
+/**
+ * @brief FASO::runInstance Runs one swarm from random starting positions for at most the configured
+ * number of iterations, stopping early once it converges, and stores where its agents end up.
+ * @details Instances run side by side, instance 0 on the calling thread and the others on the thread
+ * pool. Every instance draws from its own random streams (see randomStreamId()), so results don't
+ * depend on scheduling. Only instance 0 is shown on the canvas, so it is the only one that publishes
+ * snapshots and waits after each one.
+ * @param instance The instance to run.
+ * @param xPositions Result array for final x positions, swarm size entries per instance.
+ * @param yPositions Result array for final y positions, swarm size entries per instance.
+ */
+void FASO::runInstance(Instance &instance, double *xPositions, double *yPositions) {
+    Swarm& agents = instance.agents;
+    agents.resize(m_swarmSize);
+    instance.values.resize(m_swarmSize);
+    instance.crowding.resize(m_swarmSize);
+    for (int i = 0; i < m_swarmSize; i++) { //create the swarm...
+        RandomStream random(m_seed, 0, i, randomStreamId(instance.id, RandomPlacement));
+        agents.x[i] = random.uniform(m_dataMinX, m_dataMaxX);
+        agents.y[i] = random.uniform(m_dataMinY, m_dataMaxY);
+    }
 
+    bool displayed = (instance.id == 0) && !m_headless;
+    instance.convergence.setCriteria(m_convergence);
+    instance.convergence.reset();
+    for (int i = 0; i < m_iterations; i++) {
+        rebuildAgentGrid(instance);
+        updateHappiness(instance);
+        //Stopping here, before the moves, leaves the swarm exactly as it was measured
+        if (i > 0 && instance.convergence.isEnabled()
+                && instance.convergence.observe(meanValue(instance), i - 1))
+            break;
+        updateRanges(instance);
+        for (int j = 0; j < agents.size(); j++) {
+            RandomStream random(m_seed, i, j, randomStreamId(instance.id, RandomMoves));
+            move(instance, j, random);
+        }
+        instance.iterationsRun = i + 1;
 
-    free(xPositions);
-    free(yPositions);
-    printf("\n\nFinished...\n");
-    emit finished();
-}
-
+        if (displayed) {
+            printf("Finished iteration %i...\n", i);
+            if (i % UPDATE_RATE == 0) {
+                if (m_snapshots.publish(agents, i)) {
+                    emit snapshotReady();
+                    printf("\tupdating...");
+                }
+                sleep(MOVEMENT_DELAY);
+            }
+        }
+    }
 
+    for (int i = 0; i < agents.size(); i++) { //save positions...
+        int index = (instance.id * m_swarmSize) + i;
+        xPositions[index] = agents.x[i];
+        yPositions[index] = agents.y[i];
+    }
 
+    if (instance.convergence.converged())
+        printf("Finished instance %i, converged at iteration %i\n", instance.id, instance.convergence.convergedAt());
+    else
+        printf("Finished instance %i, did not converge within %i iterations\n", instance.id, m_iterations);
+}
 
+/**
+ * @brief FASO::iterationsRun The most iterations any instance of the last run needed.
+ */
+int FASO::iterationsRun() const {
+    int iterations = 0;
+    for (unsigned int i = 0; i < m_swarms.size(); i++)
+        iterations = std::max(iterations, m_swarms[i].iterationsRun);
+    return iterations;
+}
 
-void FASO::updateHappiness() {
-    for (unsigned int i = 0; i < m_agents.size(); i++) {
-        Agent* agent = m_agents[i];
-        agent->happiness = calculateHappiness(agent);
+/**
+ * @brief FASO::updateHappiness Re-evaluates every agent at its current position, and stores its
+ * happiness against the lowest value found once they all have been. Done once per iteration.
+ */
+void FASO::updateHappiness(Instance &instance) {
+    Swarm& agents = instance.agents;
+    for (int i = 0; i < agents.size(); i++) {
+        instance.values[i] = objectiveFunction(instance, agents.x[i], agents.y[i]);
+        instance.crowding[i] = CROWDING_ADVERSION_FACTOR * (double)agentCountWithinRange(instance, i, agents.crowdingRange[i]) + 1.0;
     }
+    for (int i = 0; i < agents.size(); i++)
+        agents.happiness[i] = happiness(instance, i);
 }
-double FASO::calculateHappiness(Agent *agent) {
-    //h(i) = O(p_i) / (|A(p_i, r_c^i)| + 1)
 
-    double objectiveFunctionValue = objectiveFunction(agent->x, agent->y);
-    double neighborScore = CROWDING_ADVERSION_FACTOR * (double)agentsWithinCrowdingRange(agent).size();
+/**
+ * @brief FASO::meanValue The mean landscape value under the swarm, as of the last updateHappiness().
+ * What convergence is judged on.
+ */
+double FASO::meanValue(const Instance &instance) {
+    double total = 0;
+    for (unsigned int i = 0; i < instance.values.size(); i++)
+        total += instance.values[i];
+    return instance.values.empty() ? 0 : total / instance.values.size();
+}
 
-    double totalScore = objectiveFunctionValue / (neighborScore + 1.0);
-    return totalScore;
+/**
+ * @brief FASO::calculateHappiness Evaluates an agent at its current position.
+ * @return The agent's happiness there, against the lowest value found so far.
+ */
+double FASO::calculateHappiness(Instance &instance, int agent) {
+    const Swarm& agents = instance.agents;
+    instance.values[agent] = objectiveFunction(instance, agents.x[agent], agents.y[agent]);
+    instance.crowding[agent] = CROWDING_ADVERSION_FACTOR * (double)agentCountWithinRange(instance, agent, agents.crowdingRange[agent]) + 1.0;
+    return happiness(instance, agent);
 }
-double FASO::objectiveFunction(double x, double y) {
+
+/**
+ * @brief FASO::objectiveFunction Evaluates the landscape, and records the value if it is the lowest
+ * one found so far. Nothing is re-evaluated when it is: every happiness read goes through happiness(),
+ * which always uses the latest lowest value.
+ */
+double FASO::objectiveFunction(Instance &instance, double x, double y) {
     double result = landscape(x, y);
-    if (result < m_lowestValue) {
-        m_lowestValue = result;
-        printf("New lowest: %4.2f\n", m_lowestValue);
-        updateHappiness();
+    if (result < instance.lowestValue) {
+        instance.lowestValue = result;
+        if (!m_headless)
+            printf("New lowest: %4.2f\n", instance.lowestValue);
     }
+    return result;
+}
 
-    return 1.0 / (result - m_lowestValue);
+/**
+ * @brief FASO::happiness An agent's happiness against the lowest value found so far, from the parts
+ * stored when it was last evaluated.
+ */
+double FASO::happiness(const Instance &instance, int agent) {
+    return happiness(instance.values[agent], instance.crowding[agent], instance.lowestValue);
+}
+
+/**
+ * @brief FASO::happiness Happiness at a landscape value, against the given lowest value.
+ * @details h(i) = O(p_i) / (|A(p_i, r_c^i)| + 1), with O(p_i) = 1 / (value - lowest). Only O depends
+ * on the lowest value, so it is applied here instead of being baked into the stored state.
+ * @param crowding The crowding divisor, |A(p_i, r_c^i)| weighted and plus one.
+ */
+double FASO::happiness(double value, double crowding, double lowestValue) {
+    double objectiveFunctionValue = 1.0 / (value - lowestValue);
+    return objectiveFunctionValue / crowding;
 }
 
 
 
 
-void FASO::updateRanges() {
-    for (unsigned int i = 0; i < m_agents.size(); i++) {
-        Agent *agent = m_agents[i];
-        double positionGoodness = 1.0 / landscape(agent->x, agent->y);
+void FASO::updateRanges(Instance &instance) {
+    Swarm& agents = instance.agents;
+    for (int i = 0; i < agents.size(); i++) {
+        double positionGoodness = 1.0 / landscape(agents.x[i], agents.y[i]);
 
         double r_f = m_minRange + ((m_agentSensorRange - m_minRange) / (1.0 + AGENT_BETA * positionGoodness));
 
-        agent->foragingRange = (r_f + agent->foragingRange) * 0.5;
-        agent->crowdingRange = agent->foragingRange * CROWDING_TO_FORAGE_DIST_RATIO;
+        agents.foragingRange[i] = (r_f + agents.foragingRange[i]) * 0.5;
+        agents.crowdingRange[i] = agents.foragingRange[i] * CROWDING_TO_FORAGE_DIST_RATIO;
     }
 }
-void FASO::move(Agent *agent) {
-    std::vector<Agent*> neighbors =  agentsWithinForagingRange(agent);    //bestAgentInRange(agent);   //best agent in range.
+void FASO::move(Instance &instance, int agent, RandomStream &random) {
+    const Swarm& agents = instance.agents;
+    std::vector<int> neighbors =  agentsWithinForagingRange(instance, agent);    //bestAgentInRange(agent);   //best agent in range.
     if (neighbors.size() != 0) {    //has neighbors
-        Agent* bestNeighbor = neighbors[0];
+        int bestNeighbor = neighbors[0];
+        double bestHappiness = happiness(instance, bestNeighbor);
         for (unsigned int i = 1; i < neighbors.size(); i++) {
-            Agent* candidate = neighbors[i];
-            if (candidate->happiness > bestNeighbor->happiness)
+            int candidate = neighbors[i];
+            double candidateHappiness = happiness(instance, candidate);
+            if (candidateHappiness > bestHappiness) {
                 bestNeighbor = candidate;
+                bestHappiness = candidateHappiness;
+            }
         }
-        if (bestNeighbor->happiness > agent->happiness) {   //found a better neighbor we should move towards
-            moveTowards(agent, bestNeighbor);
+        if (bestHappiness > happiness(instance, agent)) {   //found a better neighbor we should move towards
+            moveTowards(instance, agent, bestNeighbor, random);
         } else {    //otherwise, just move randomly :(
-            moveRandomly(agent);
+            moveRandomly(instance, agent, random);
         }
     } else {    //all alone...move in direction of gradient
 
-        double unitX = gradientX(agent->x, agent->y);
-        double unitY = gradientY(agent->x, agent->y);
+        double agentX = agents.x[agent];
+        double agentY = agents.y[agent];
+        double unitX = gradientX(agentX, agentY);
+        double unitY = gradientY(agentX, agentY);
         if (unitX == 0.0 && unitY == 0.0) { //already at a max/min? move randomly
-            moveRandomly(agent);
+            moveRandomly(instance, agent, random);
             return;
         }
 
@@ -177,45 +291,51 @@ void FASO::move(Agent *agent) {
         unitX /= -norm;     //we want to go down the slope...
         unitY /= -norm;
 
-        double magnitude = randomDouble(0.1, 1);
-        double newX = agent->x + (unitX * magnitude);
-        double newY = agent->y + (unitY * magnitude);
+        double magnitude = random.uniform(0.1, 1);
+        double newX = agentX + (unitX * magnitude);
+        double newY = agentY + (unitY * magnitude);
 
         Q_ASSERT_X(nanTest(newX), "Failed NaN", __FUNCTION__);
         Q_ASSERT_X(nanTest(newY), "Failed NaN", __FUNCTION__);
 
-        agent->x = newX;
-        agent->y = newY;
+        setPosition(instance, agent, newX, newY);
     }
 }
-void FASO::moveTowards(Agent *agentOne, Agent *agentTwo) {
-    double crowdingFactor = (agentOne->crowdingRange + agentTwo->crowdingRange) * 0.5;
-    double agentDistance = pointDistance(agentOne->x, agentTwo->x, agentOne->y, agentTwo->y) - crowdingFactor;
+void FASO::moveTowards(Instance &instance, int agentOne, int agentTwo, RandomStream &random) {
+    Swarm& agents = instance.agents;
+    double oneX = agents.x[agentOne];
+    double oneY = agents.y[agentOne];
+    double twoX = agents.x[agentTwo];
+    double twoY = agents.y[agentTwo];
+
+    double crowdingFactor = (agents.crowdingRange[agentOne] + agents.crowdingRange[agentTwo]) * 0.5;
+    double agentDistance = pointDistance(oneX, twoX, oneY, twoY) - crowdingFactor;
 
     if (agentDistance == 0)
         return;
 
-    double moveMagnitude = std::min(randomDouble(0, agentOne->foragingRange), agentDistance) * randomDouble(0, 0.9);
-    double unitVectorX = (agentTwo->x - agentOne->x) / agentDistance;
-    double unitVectorY = (agentTwo->y - agentOne->y) / agentDistance;
+    double moveMagnitude = std::min(random.uniform(0, agents.foragingRange[agentOne]), agentDistance) * random.uniform(0, 0.9);
+    double unitVectorX = (twoX - oneX) / agentDistance;
+    double unitVectorY = (twoY - oneY) / agentDistance;
 
-    double newX = agentOne->x + (moveMagnitude * unitVectorX);
-    double newY = agentOne->y + (moveMagnitude * unitVectorY);
+    double newX = oneX + (moveMagnitude * unitVectorX);
+    double newY = oneY + (moveMagnitude * unitVectorY);
 
     Q_ASSERT_X(nanTest(newX), "Failed NaN", __FUNCTION__);
     Q_ASSERT_X(nanTest(newY), "Failed NaN", __FUNCTION__);
 
-    agentOne->x = newX;
-    agentOne->y = newY;
-    agentOne->happiness = calculateHappiness(agentOne);
+    setPosition(instance, agentOne, newX, newY);
+    calculateHappiness(instance, agentOne);     //stores the parts that happiness() reads
 }
-void FASO::moveRandomly(Agent *agent) {
-    double initialX = agent->x;
-    double initialY = agent->y;
-    double initialHappiness = agent->happiness;
+void FASO::moveRandomly(Instance &instance, int agent, RandomStream &random) {
+    Swarm& agents = instance.agents;
+    double initialX = agents.x[agent];
+    double initialY = agents.y[agent];
+    double initialValue = instance.values[agent];
+    double initialCrowding = instance.crowding[agent];
 
-    double moveMagnitude =  randomDouble(0.0, agent->foragingRange * RANDOM_MOVE_FACTOR + 1);
-    double moveDirection = randomDouble(0, 360) * (PI / 180.0);
+    double moveMagnitude =  random.uniform(0.0, agents.foragingRange[agent] * RANDOM_MOVE_FACTOR + 1);
+    double moveDirection = random.uniform(0, 360) * (PI / 180.0);
 
     double posX = initialX + (cos(moveDirection) * moveMagnitude);
     double posY = initialY + (sin(moveDirection) * moveMagnitude);
@@ -223,40 +343,49 @@ void FASO::moveRandomly(Agent *agent) {
     Q_ASSERT_X(nanTest(posX), "Failed NaN", __FUNCTION__);
     Q_ASSERT_X(nanTest(posY), "Failed NaN", __FUNCTION__);
 
-    agent->x = posX;
-    agent->y = posY;
-    double newHappiness = calculateHappiness(agent);
-    if (newHappiness >= initialHappiness) { //did we find a better position?
-        agent->happiness = newHappiness;
+    setPosition(instance, agent, posX, posY);
+    double newHappiness = calculateHappiness(instance, agent);
+    double initialHappiness = happiness(initialValue, initialCrowding, instance.lowestValue);    //the new position may have lowered the baseline
+    if (newHappiness >= initialHappiness) //did we find a better position?
         return;
-    }
 
     //otherwise, move back...
-    agent->x = initialX;
-    agent->y = initialY;
+    setPosition(instance, agent, initialX, initialY);
+    instance.values[agent] = initialValue;
+    instance.crowding[agent] = initialCrowding;
+}
+void FASO::setPosition(Instance &instance, int agent, double x, double y) {
+    //keep the agent grid in sync, so neighbor queries see the move straight away
+    Swarm& agents = instance.agents;
+    double oldX = agents.x[agent];
+    double oldY = agents.y[agent];
+    agents.x[agent] = x;
+    agents.y[agent] = y;
+    instance.agentGrid.relocate(agent, oldX, oldY);
+}
+void FASO::rebuildAgentGrid(Instance &instance) {
+    //Agents aren't clamped to the search space here, but the grid folds strays into its border cells.
+    const Swarm& agents = instance.agents;
+    instance.agentGrid.build(agents.x.data(), agents.y.data(), agents.size(),
+                             m_agentSensorRange, m_dataMinX, m_dataMinY, m_dataMaxX, m_dataMaxY);
 }
-
 
 
 //RANGE FUNCTIONS
-std::vector<Agent*> FASO::agentsWithinCrowdingRange(Agent *agent) const {
-    return agentsWithinRange(agent, agent->crowdingRange);
-}
-std::vector<Agent*> FASO::agentsWithinForagingRange(Agent *agent) const {
-    return agentsWithinRange(agent, agent->foragingRange);
-}
-std::vector<Agent*> FASO::agentsWithinRange(Agent *agent, double range) const {
-    std::vector<Agent*> closeAgents;
-    for (unsigned int i = 0; i < m_agents.size(); i++) {
-        Agent* testAgent = m_agents[i];
-        if (testAgent == agent)
-            continue;
-        double distance = sqrt(pow(testAgent->x - agent->x, 2) + pow(testAgent->y - agent->y, 2));
-        if (distance <= range)
-            closeAgents.push_back(testAgent);
-    }
+std::vector<int> FASO::agentsWithinCrowdingRange(const Instance &instance, int agent) const {
+    return agentsWithinRange(instance, agent, instance.agents.crowdingRange[agent]);
+}
+std::vector<int> FASO::agentsWithinForagingRange(const Instance &instance, int agent) const {
+    return agentsWithinRange(instance, agent, instance.agents.foragingRange[agent]);
+}
+std::vector<int> FASO::agentsWithinRange(const Instance &instance, int agent, double range) const {
+    std::vector<int> closeAgents;
+    instance.agentGrid.query(instance.agents.x[agent], instance.agents.y[agent], range, closeAgents, agent);
     return closeAgents;
 }
+int FASO::agentCountWithinRange(const Instance &instance, int agent, double range) const {
+    return instance.agentGrid.count(instance.agents.x[agent], instance.agents.y[agent], range, agent);
+}
 
 
 
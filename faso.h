@@ -2,12 +2,17 @@
 #define FASO_H
 
 
+#include "def.h"
+#include "spatialgrid.h"
+#include "snapshotring.h"
+#include "convergence.h"
+
 #include <QObject>
+#include <string>
 #include <vector>
 
 enum TestFunction { Styblinski, Ackley };
 
-class Agent;
 class FASO : public QObject
 {
     Q_OBJECT
@@ -20,18 +25,53 @@ public:
          QObject *parent = 0);
     ~FASO();
 
+    void setHeadless(bool headless) { m_headless = headless; }
+    void setSeed(unsigned long long seed) { m_seed = seed; }
+    void setConvergence(const ConvergenceCriteria& criteria) { m_convergence = criteria; }
+    void setResultsFile(const std::string& path) { m_resultsFile = path; }
+
+    int iterationsRun() const;
+    SnapshotRing* snapshots() { return &m_snapshots; }
+
 public slots:
     void start();
 
 signals:
-    void update(std::vector<Agent*>* agents);
+    void snapshotReady();    //take it from snapshots()
     void finished();
 
 private:
-    std::vector<Agent*> m_agents;
+    /**
+     * @brief The Instance struct Everything one independent swarm run changes as it goes. Instances
+     * run concurrently, so the FASO members themselves stay read-only while they do.
+     * @details Happiness is measured against the lowest value found so far, which keeps dropping.
+     * Rather than re-evaluating the whole swarm whenever it does, each agent keeps the parts of its
+     * happiness that don't depend on it (see happiness()), and Swarm::happiness is only refreshed
+     * once per iteration.
+     */
+    struct Instance {
+        int id;
+        Swarm agents;
+        SpatialGrid agentGrid;
+        double lowestValue;
+        std::vector<double> values;     //landscape value at each agent's last evaluated position
+        std::vector<double> crowding;   //crowding divisor at that position
+        ConvergenceMonitor convergence;
+        int iterationsRun;
+
+        Instance(int instanceId, double lowest)
+            : id(instanceId), lowestValue(lowest), iterationsRun(0) {}
+    };
+
+    std::vector<Instance> m_swarms;
     int m_swarmSize;
-    int m_iterations;
+    int m_iterations;       //upper bound; each instance stops early once its swarm converges
     int m_instances;
+    bool m_headless;    //no per-iteration updates or animation delays
+    SnapshotRing m_snapshots;   //the displayed instance, for the canvas
+    unsigned long long m_seed;
+    ConvergenceCriteria m_convergence;
+    std::string m_resultsFile;  //final positions are written here after every run, if set
 
     TestFunction m_testFunction;
     double m_dataMinX;
@@ -42,20 +82,27 @@ private:
     double m_minRange;
     double m_agentStepSize;
 
-    double m_lowestValue;
-
-    void updateHappiness();
-    double calculateHappiness(Agent *agent);
-    double objectiveFunction(double x, double y);
-
-    void updateRanges();
-    void move(Agent* agent);
-    void moveTowards(Agent *agentOne, Agent *agentTwo);
-    void moveRandomly(Agent *agent);
-
-    std::vector<Agent*> agentsWithinCrowdingRange(Agent* agent) const;
-    std::vector<Agent*> agentsWithinForagingRange(Agent* agent) const;
-    std::vector<Agent*> agentsWithinRange(Agent* agent, double range) const;
+    void runInstance(Instance& instance, double* xPositions, double* yPositions);
+    void writeResults(const double* xPositions, const double* yPositions);
+
+    void updateHappiness(Instance& instance);
+    double calculateHappiness(Instance& instance, int agent);
+    double objectiveFunction(Instance& instance, double x, double y);
+    static double happiness(const Instance& instance, int agent);
+    static double happiness(double value, double crowding, double lowestValue);
+    static double meanValue(const Instance& instance);
+
+    void updateRanges(Instance& instance);
+    void move(Instance& instance, int agent, RandomStream& random);
+    void moveTowards(Instance& instance, int agentOne, int agentTwo, RandomStream& random);
+    void moveRandomly(Instance& instance, int agent, RandomStream& random);
+    void setPosition(Instance& instance, int agent, double x, double y);
+    void rebuildAgentGrid(Instance& instance);
+
+    std::vector<int> agentsWithinCrowdingRange(const Instance& instance, int agent) const;
+    std::vector<int> agentsWithinForagingRange(const Instance& instance, int agent) const;
+    std::vector<int> agentsWithinRange(const Instance& instance, int agent, double range) const;
+    int agentCountWithinRange(const Instance& instance, int agent, double range) const;
 
     void sleep(int millis);
     double landscape(double x, double y) const;
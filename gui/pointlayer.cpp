@@ -0,0 +1,202 @@
+#include "pointlayer.h"
+
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+
+PointLayer::PointLayer(Style style, QGraphicsItem *parent) :
+    QGraphicsItem(parent)
+{
+    m_style = style;
+    m_progress = 1;
+    m_color = Qt::black;
+    m_outline = Qt::transparent;
+    m_dotSize = 1;
+    m_pen = QPen(Qt::black, 1);
+    m_brush = Qt::NoBrush;
+    m_trails = false;
+}
+
+/**
+ * @brief PointLayer::setTargets Starts moving the points to new positions. Where each point is drawn
+ * right now becomes the start of its move, and the progress goes back to 0; call setProgress() to
+ * move them. If the number of points changed, the points start at their targets instead.
+ * @param centers Scene position of every point.
+ * @param radii Horizontal and vertical radius of every point, for Circles.
+ */
+void PointLayer::setTargets(const std::vector<QPointF> &centers, const std::vector<QSizeF> &radii) {
+    prepareGeometryChange();
+    if (centers.size() == m_targets.size()) {
+        const QPointF* current = currentPositions();
+        m_starts.assign(current, current + m_targets.size());
+    } else {
+        m_starts = centers;
+    }
+    m_targets = centers;
+    m_radii = radii;
+    m_radii.resize(m_targets.size());
+    m_progress = 0;
+    updateBounds();
+    update();
+}
+
+/**
+ * @brief PointLayer::setProgress Draws the points the given fraction of the way from the start of
+ * their move to their targets.
+ */
+void PointLayer::setProgress(qreal progress) {
+    m_progress = std::min(std::max(progress, (qreal)0), (qreal)1);
+    update();
+}
+
+/**
+ * @brief PointLayer::setRuns Splits the points into consecutive runs of one color each (Dots only).
+ * Points after the last run are drawn in the layer's color.
+ */
+void PointLayer::setRuns(const std::vector<Run> &runs) {
+    m_runs = runs;
+    m_sprites.clear();
+    update();
+}
+
+void PointLayer::setDotSize(qreal size) {
+    prepareGeometryChange();
+    m_dotSize = size;
+    m_sprites.clear();
+    updateBounds();
+    update();
+}
+
+QRectF PointLayer::boundingRect() const {
+    return m_bounds;
+}
+
+/**
+ * @brief PointLayer::paint Draws every point at its interpolated position: first the trails, then
+ * for Dots each run of colors in one call, and for Circles one ellipse each.
+ */
+void PointLayer::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+    const int count = (int)m_targets.size();
+    if (count == 0)
+        return;
+    const QPointF* positions = currentPositions();
+
+    if (m_trails) {
+        m_lines.resize(count);
+        for (int i = 0; i < count; i++)
+            m_lines[i] = QLineF(m_starts[i], positions[i]);
+        painter->setPen(QPen(Qt::black, 1));
+        painter->drawLines(m_lines.data(), count);
+    }
+
+    if (m_style == Circles) {
+        painter->setPen(m_pen);
+        painter->setBrush(m_brush);
+        for (int i = 0; i < count; i++)
+            painter->drawEllipse(positions[i], m_radii[i].width(), m_radii[i].height());
+        return;
+    }
+
+    //Sprites are rendered at the device's pixel ratio and scaled back down, so they stay sharp
+    const qreal ratio = painter->device()->devicePixelRatioF();
+    if (m_sprites.empty() || m_sprites[0].devicePixelRatio() != ratio) {
+        m_sprites.clear();
+        for (unsigned int r = 0; r < m_runs.size(); r++)
+            m_sprites.push_back(sprite(m_runs[r].color, ratio));
+        m_sprites.push_back(sprite(m_color, ratio));
+    }
+
+    const qreal scale = 1 / ratio;
+    const QRectF source(QPointF(0, 0), m_sprites[0].size());
+    m_fragments.resize(count);
+    for (int i = 0; i < count; i++)
+        m_fragments[i] = QPainter::PixmapFragment::create(positions[i], source, scale, scale);
+
+    int begin = 0;
+    for (unsigned int r = 0; r <= m_runs.size() && begin < count; r++) {
+        int end = (r < m_runs.size()) ? std::min(m_runs[r].end, count) : count;
+        if (end > begin)
+            painter->drawPixmapFragments(m_fragments.data() + begin, end - begin, m_sprites[r]);
+        begin = std::max(begin, end);
+    }
+}
+
+/**
+ * @brief PointLayer::sprite Renders one dot of the given color, with the outline around it, for
+ * paint() to stamp at every point.
+ * @param devicePixelRatio Pixels per scene unit of the device the sprite will be drawn to.
+ */
+QPixmap PointLayer::sprite(const QColor &color, qreal devicePixelRatio) const {
+    const qreal side = spriteSize();
+    const int pixels = (int)std::ceil(side * devicePixelRatio);
+    QPixmap dot(pixels, pixels);
+    dot.setDevicePixelRatio(devicePixelRatio);
+    dot.fill(Qt::transparent);
+
+    QPainter painter(&dot);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setPen(Qt::NoPen);
+    const QPointF center(side / 2, side / 2);
+    if (m_outline.alpha() > 0) {
+        painter.setBrush(m_outline);
+        painter.drawEllipse(center, m_dotSize / 2 + 1, m_dotSize / 2 + 1);
+    }
+    painter.setBrush(color);
+    painter.drawEllipse(center, m_dotSize / 2, m_dotSize / 2);
+    return dot;
+}
+
+/**
+ * @brief PointLayer::spriteSize Width and height of a dot sprite, in scene units: the dot, its
+ * outline and a pixel of room for the antialiasing on either side.
+ */
+qreal PointLayer::spriteSize() const {
+    return std::ceil(m_dotSize + 2) + 2;
+}
+
+/**
+ * @brief PointLayer::currentPositions Where every point is drawn at the current progress. Only
+ * interpolates (into a scratch buffer) while a move is under way.
+ */
+const QPointF* PointLayer::currentPositions() const {
+    if (m_progress >= 1)
+        return m_targets.data();
+    if (m_progress <= 0)
+        return m_starts.data();
+    m_current.resize(m_targets.size());
+    for (unsigned int i = 0; i < m_targets.size(); i++)
+        m_current[i] = currentPosition(i);
+    return m_current.data();
+}
+
+QPointF PointLayer::currentPosition(int index) const {
+    return m_starts[index] + (m_targets[index] - m_starts[index]) * m_progress;
+}
+
+/**
+ * @brief PointLayer::updateBounds Covers the whole move of every point, so the bounds don't change
+ * while the points are animated.
+ */
+void PointLayer::updateBounds() {
+    if (m_targets.empty()) {
+        m_bounds = QRectF();
+        return;
+    }
+    qreal minX = m_targets[0].x(), maxX = minX;
+    qreal minY = m_targets[0].y(), maxY = minY;
+    qreal margin = (m_style == Dots) ? spriteSize() / 2 : 0;
+    for (unsigned int i = 0; i < m_targets.size(); i++) {
+        const QPointF& start = m_starts[i];
+        const QPointF& target = m_targets[i];
+        minX = std::min(minX, std::min(start.x(), target.x()));
+        maxX = std::max(maxX, std::max(start.x(), target.x()));
+        minY = std::min(minY, std::min(start.y(), target.y()));
+        maxY = std::max(maxY, std::max(start.y(), target.y()));
+        if (m_style == Circles)
+            margin = std::max(margin, std::max(m_radii[i].width(), m_radii[i].height()) + m_pen.widthF());
+    }
+    m_bounds = QRectF(minX - margin, minY - margin, maxX - minX + 2 * margin, maxY - minY + 2 * margin);
+}
@@ -0,0 +1,91 @@
+#ifndef POINTLAYER_H
+#define POINTLAYER_H
+
+#include <QGraphicsItem>
+#include <QPainter>
+#include <QPixmap>
+#include <QPen>
+#include <QBrush>
+#include <QColor>
+
+#include <vector>
+
+/**
+ * @brief The PointLayer class One graphics item that draws a whole set of points (the data, the
+ * agents, or their ranges) from contiguous coordinate buffers, instead of one item per point.
+ * @details Dots are stamped from a pre-rendered sprite of one dot (outline included), in one
+ * drawPixmapFragments() call per color, so the cost of a frame is one pass over the buffer rather
+ * than a scene full of items to index and sort. Rasterizing every dot instead is much slower: wide
+ * round-capped drawPoints() take longer than one ellipse item per point. Circles (the ranges) still
+ * take one drawEllipse() each, but share the pen and brush.
+ *
+ * Points move by interpolation: setTargets() keeps where every point is drawn right now as the start
+ * of the move, and setProgress() slides them from there to the targets, so a single animation can
+ * drive every layer.
+ *
+ * Points can be split into runs that each get their own color (see setRuns()); by default every
+ * point uses the layer's color.
+ */
+class PointLayer : public QGraphicsItem
+{
+public:
+    enum Style {
+        Dots,       //filled dots of a fixed size, optionally outlined
+        Circles     //ellipses with a radius per point
+    };
+
+    /**
+     * @brief The Run struct The points up to (not including) end are drawn in color.
+     */
+    struct Run {
+        int end;
+        QColor color;
+    };
+
+    explicit PointLayer(Style style, QGraphicsItem *parent = 0);
+
+    void setTargets(const std::vector<QPointF>& centers, const std::vector<QSizeF>& radii = std::vector<QSizeF>());
+    void setProgress(qreal progress);
+    void setRuns(const std::vector<Run>& runs);
+
+    void setColor(const QColor& color) { m_color = color; m_sprites.clear(); update(); }
+    void setOutline(const QColor& outline) { m_outline = outline; m_sprites.clear(); update(); }
+    void setDotSize(qreal size);
+    void setPen(const QPen& pen) { m_pen = pen; update(); }
+    void setBrush(const QBrush& brush) { m_brush = brush; update(); }
+    void setTrails(bool trails) { m_trails = trails; update(); }
+
+    int count() const { return (int)m_targets.size(); }
+
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+    Style m_style;
+    std::vector<QPointF> m_starts;      //where the current move started
+    std::vector<QPointF> m_targets;     //where it ends
+    std::vector<QSizeF> m_radii;        //per point, for Circles
+    std::vector<Run> m_runs;
+    qreal m_progress;                   //0 at the starts, 1 at the targets
+
+    QColor m_color;
+    QColor m_outline;   //Dots only; transparent for none
+    qreal m_dotSize;
+    QPen m_pen;         //Circles only
+    QBrush m_brush;
+    bool m_trails;      //draw a line from the start of every move to the point
+
+    QRectF m_bounds;
+    mutable std::vector<QPointF> m_current;     //interpolated positions, rebuilt by every paint
+    mutable std::vector<QLineF> m_lines;
+    std::vector<QPainter::PixmapFragment> m_fragments;
+    std::vector<QPixmap> m_sprites;     //one per run, then the layer's color; rebuilt when emptied
+
+    const QPointF* currentPositions() const;
+    QPointF currentPosition(int index) const;
+    QPixmap sprite(const QColor& color, qreal devicePixelRatio) const;
+    qreal spriteSize() const;
+    void updateBounds();
+};
+
+#endif // POINTLAYER_H
@@ -1,6 +0,0 @@
-#include "qgraphicsellipseitemobject.h"
-
-QGraphicsEllipseItemObject::QGraphicsEllipseItemObject(QObject *parent) :
-    QObject(parent)
-{
-}
@@ -1,6 +0,0 @@
-#include "qgraphicslineitemobject.h"
-
-QGraphicsLineItemObject::QGraphicsLineItemObject(QObject *parent) :
-    QObject(parent)
-{
-}
@@ -0,0 +1,380 @@
+#include "kdtree.h"
+#include "radiuskernels.h"
+
+#include <algorithm>
+
+/**
+ * @brief KdTree::build Builds the tree over the given points, replacing any previous contents.
+ * @param columns One array of coordinates per dimension.
+ * @param dimension Number of dimensions.
+ * @param count Number of points.
+ */
+void KdTree::build(const double * const *columns, int dimension, int count) {
+    m_dimension = dimension;
+    m_nodes.clear();
+    m_bounds.clear();
+    m_sums.clear();
+    m_coordinates.clear();
+    m_index.clear();
+    if (count <= 0)
+        return;
+
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    m_nodes.reserve(2 * (count / LEAF_SIZE + 1));
+    m_bounds.reserve(m_nodes.capacity() * 2 * dimension);
+    buildNode(0, count, order, columns);
+
+    m_index = order;
+    m_coordinates.resize((size_t)dimension * count);
+    for (int d = 0; d < dimension; d++) {
+        double* column = &m_coordinates[(size_t)d * count];
+        for (int i = 0; i < count; i++)
+            column[i] = columns[d][order[i]];
+    }
+
+    //Children always come after their parent, so a backwards sweep sees them summed first.
+    m_sums.assign(m_nodes.size() * dimension, 0.0);
+    for (int n = (int)m_nodes.size() - 1; n >= 0; n--) {
+        const Node& node = m_nodes[n];
+        double* sums = &m_sums[(size_t)n * dimension];
+        for (int d = 0; d < dimension; d++) {
+            if (node.left < 0) {
+                const double* coordinates = column(d);
+                for (int i = node.begin; i < node.end; i++)
+                    sums[d] += coordinates[i];
+            } else {
+                sums[d] = nodeSums(node.left)[d] + nodeSums(node.right)[d];
+            }
+        }
+    }
+}
+
+/**
+ * @brief KdTree::countWithinRadius Counts the points within range of a position.
+ * @param point Position to search around, one coordinate per dimension.
+ * @param range Search radius (inclusive).
+ * @return Number of points in range.
+ */
+template <int D>
+int KdTree::countWithinRadius(const double* point, double range) const {
+    if (m_nodes.empty() || range < 0)
+        return 0;
+
+    const double rangeSquared = range * range;
+    int hits[LEAF_SIZE];
+    int found = 0;
+    int stack[MAX_DEPTH];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int index = stack[--depth];
+        const Node& node = m_nodes[index];
+        if (minDistanceSquared<D>(index, point) > rangeSquared)
+            continue;
+        if (maxDistanceSquared<D>(index, point) <= rangeSquared) {
+            found += node.end - node.begin;
+            continue;
+        }
+        if (node.left < 0) {
+            if (D == 2)
+                found += radiusCount(column(0) + node.begin, column(1) + node.begin, node.end - node.begin,
+                                     point[0], point[1], range);
+            else
+                found += leafCollect<D>(node, point, range, hits);
+            continue;
+        }
+        stack[depth++] = node.left;
+        stack[depth++] = node.right;
+    }
+    return found;
+}
+
+/**
+ * @brief KdTree::anyWithinRadius Tests whether there is at least one point within range of a
+ * position, stopping at the first one found.
+ * @param point Position to search around, one coordinate per dimension.
+ * @param range Search radius (inclusive).
+ * @return True if any point is in range.
+ */
+template <int D>
+bool KdTree::anyWithinRadius(const double* point, double range) const {
+    if (m_nodes.empty() || range < 0)
+        return false;
+
+    const double rangeSquared = range * range;
+    int hits[LEAF_SIZE];
+    int stack[MAX_DEPTH];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int index = stack[--depth];
+        const Node& node = m_nodes[index];
+        if (minDistanceSquared<D>(index, point) > rangeSquared)
+            continue;
+        if (maxDistanceSquared<D>(index, point) <= rangeSquared)
+            return true;    //nodes are never empty
+        if (node.left < 0) {
+            if (leafCollect<D>(node, point, range, hits) > 0)
+                return true;
+            continue;
+        }
+        stack[depth++] = node.left;
+        stack[depth++] = node.right;
+    }
+    return false;
+}
+
+/**
+ * @brief KdTree::sumWithinRadius Counts the points within range of a position, and adds up their
+ * coordinates, in a single walk of the tree.
+ * @param point Position to search around, one coordinate per dimension.
+ * @param range Search radius (inclusive).
+ * @param sums Coordinate sums, one per dimension, that the points in range are added to.
+ * @return Number of points in range.
+ */
+template <int D>
+int KdTree::sumWithinRadius(const double* point, double range, double* sums) const {
+    if (m_nodes.empty() || range < 0)
+        return 0;
+
+    const int dimensions = dimensionCount<D>(m_dimension);
+    const double rangeSquared = range * range;
+    int hits[LEAF_SIZE];
+    int found = 0;
+    int stack[MAX_DEPTH];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int index = stack[--depth];
+        const Node& node = m_nodes[index];
+        if (minDistanceSquared<D>(index, point) > rangeSquared)
+            continue;
+        if (maxDistanceSquared<D>(index, point) <= rangeSquared) {
+            found += node.end - node.begin;
+            const double* nodeSum = nodeSums(index);
+            for (int d = 0; d < dimensions; d++)
+                sums[d] += nodeSum[d];
+            continue;
+        }
+        if (node.left < 0) {
+            int leafFound = leafCollect<D>(node, point, range, hits);
+            for (int d = 0; d < dimensions; d++) {
+                const double* coordinates = column(d) + node.begin;
+                for (int i = 0; i < leafFound; i++)
+                    sums[d] += coordinates[hits[i]];
+            }
+            found += leafFound;
+            continue;
+        }
+        stack[depth++] = node.left;
+        stack[depth++] = node.right;
+    }
+    return found;
+}
+
+/**
+ * @brief KdTree::query Finds all points within range of a position.
+ * @param point Position to search around, one coordinate per dimension.
+ * @param range Search radius (inclusive).
+ * @param out Vector that the indices of matching points are appended to.
+ */
+template <int D>
+void KdTree::query(const double* point, double range, std::vector<int> &out) const {
+    if (m_nodes.empty() || range < 0)
+        return;
+
+    const double rangeSquared = range * range;
+    int hits[LEAF_SIZE];
+    int stack[MAX_DEPTH];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int index = stack[--depth];
+        const Node& node = m_nodes[index];
+        if (minDistanceSquared<D>(index, point) > rangeSquared)
+            continue;
+        if (maxDistanceSquared<D>(index, point) <= rangeSquared) {
+            out.insert(out.end(), m_index.begin() + node.begin, m_index.begin() + node.end);
+            continue;
+        }
+        if (node.left < 0) {
+            int found = leafCollect<D>(node, point, range, hits);
+            for (int i = 0; i < found; i++)
+                out.push_back(m_index[node.begin + hits[i]]);
+            continue;
+        }
+        stack[depth++] = node.left;
+        stack[depth++] = node.right;
+    }
+}
+
+/**
+ * @brief KdTree::nearest Finds the point closest to a position.
+ * @details Depth first, always descending into the closer child first, and skipping subtrees whose
+ * box is farther away than the closest point found so far. Of several equally close points, the one
+ * with the lowest index wins, as it would in a linear scan.
+ * @param point Position to search around, one coordinate per dimension.
+ * @return Index of the closest point, or -1 if the tree is empty.
+ */
+template <int D>
+int KdTree::nearest(const double* point) const {
+    if (m_nodes.empty())
+        return -1;
+
+    const int dimensions = dimensionCount<D>(m_dimension);
+    int best = -1;
+    double bestDistance = 0;
+    int stack[MAX_DEPTH];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int index = stack[--depth];
+        const Node& node = m_nodes[index];
+        if (best >= 0 && minDistanceSquared<D>(index, point) > bestDistance)
+            continue;
+        if (node.left < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                double distance = 0;
+                for (int d = 0; d < dimensions; d++) {
+                    double delta = column(d)[i] - point[d];
+                    distance += delta * delta;
+                }
+                if (best < 0 || distance < bestDistance || (distance == bestDistance && m_index[i] < best)) {
+                    best = m_index[i];
+                    bestDistance = distance;
+                }
+            }
+            continue;
+        }
+        //pushed last, popped first
+        if (minDistanceSquared<D>(node.left, point) <= minDistanceSquared<D>(node.right, point)) {
+            stack[depth++] = node.right;
+            stack[depth++] = node.left;
+        } else {
+            stack[depth++] = node.left;
+            stack[depth++] = node.right;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief KdTree::leafCollect Scans the points of a leaf.
+ * @param hits Receives the offsets (from node.begin) of the points in range.
+ * @return Number of points in range.
+ */
+template <int D>
+int KdTree::leafCollect(const Node &node, const double *point, double range, int *hits) const {
+    const int count = node.end - node.begin;
+    if (D == 2)
+        return radiusCollect(column(0) + node.begin, column(1) + node.begin, count, point[0], point[1], range, hits);
+
+    //a dimension at a time, so each pass streams through one contiguous column
+    const int dimensions = dimensionCount<D>(m_dimension);
+    double distances[LEAF_SIZE] = { 0 };
+    for (int d = 0; d < dimensions; d++) {
+        const double* coordinates = column(d) + node.begin;
+        const double position = point[d];
+        for (int i = 0; i < count; i++) {
+            double delta = coordinates[i] - position;
+            distances[i] += delta * delta;
+        }
+    }
+
+    const double rangeSquared = range * range;
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        if (distances[i] <= rangeSquared)
+            hits[found++] = i;
+    }
+    return found;
+}
+
+/**
+ * @brief KdTree::buildNode Recursively builds the subtree over order[begin, end), splitting at the
+ * median of the widest side of the bounding box.
+ * @return Index of the new node.
+ */
+int KdTree::buildNode(int begin, int end, std::vector<int> &order, const double * const *columns) {
+    Node node;
+    node.begin = begin;
+    node.end = end;
+    node.left = node.right = -1;
+
+    int index = (int)m_nodes.size();
+    m_nodes.push_back(node);
+    m_bounds.resize(m_bounds.size() + 2 * m_dimension);
+    double* lower = &m_bounds[(size_t)index * 2 * m_dimension];
+    double* upper = lower + m_dimension;
+    int widest = 0;
+    for (int d = 0; d < m_dimension; d++) {
+        const double* column = columns[d];
+        lower[d] = upper[d] = column[order[begin]];
+        for (int i = begin + 1; i < end; i++) {
+            lower[d] = std::min(lower[d], column[order[i]]);
+            upper[d] = std::max(upper[d], column[order[i]]);
+        }
+        if (upper[d] - lower[d] > upper[widest] - lower[widest])
+            widest = d;
+    }
+
+    if (end - begin <= LEAF_SIZE)
+        return index;
+
+    int middle = begin + (end - begin) / 2;
+    const double* axis = columns[widest];
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [axis](int a, int b) { return axis[a] < axis[b]; });
+
+    int left = buildNode(begin, middle, order, columns);
+    int right = buildNode(middle, end, order, columns);
+    m_nodes[index].left = left;
+    m_nodes[index].right = right;
+    return index;
+}
+
+/**
+ * @brief KdTree::minDistanceSquared Squared distance from a position to the closest point of a node's
+ * bounding box.
+ */
+template <int D>
+double KdTree::minDistanceSquared(int node, const double *point) const {
+    const int dimensions = dimensionCount<D>(m_dimension);
+    const double* lower = lowerCorner(node);
+    const double* upper = upperCorner(node);
+    double sum = 0;
+    for (int d = 0; d < dimensions; d++) {
+        double delta = point[d] - std::min(std::max(point[d], lower[d]), upper[d]);
+        sum += delta * delta;
+    }
+    return sum;
+}
+
+/**
+ * @brief KdTree::maxDistanceSquared Squared distance from a position to the farthest corner of a node's
+ * bounding box.
+ */
+template <int D>
+double KdTree::maxDistanceSquared(int node, const double *point) const {
+    const int dimensions = dimensionCount<D>(m_dimension);
+    const double* lower = lowerCorner(node);
+    const double* upper = upperCorner(node);
+    double sum = 0;
+    for (int d = 0; d < dimensions; d++) {
+        double delta = point[d] - ((point[d] - lower[d] > upper[d] - point[d]) ? lower[d] : upper[d]);
+        sum += delta * delta;
+    }
+    return sum;
+}
+
+#define INSTANTIATE_KDTREE(D) \
+    template int KdTree::countWithinRadius<D>(const double* point, double range) const; \
+    template bool KdTree::anyWithinRadius<D>(const double* point, double range) const; \
+    template int KdTree::sumWithinRadius<D>(const double* point, double range, double* sums) const; \
+    template void KdTree::query<D>(const double* point, double range, std::vector<int>& out) const; \
+    template int KdTree::nearest<D>(const double* point) const;
+SPECIALIZED_DIMENSIONS(INSTANTIATE_KDTREE)
+INSTANTIATE_KDTREE(0)
+#undef INSTANTIATE_KDTREE
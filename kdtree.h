@@ -0,0 +1,78 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include "dimensions.h"
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief The KdTree class Static k-d tree over a set of points, used for fixed-radius queries against
+ * data that doesn't move.
+ * @details Every node keeps the bounding box, size and coordinate sums of its subtree. Radius queries
+ * drop subtrees whose box lies entirely outside of the sphere, and take subtrees whose box lies
+ * entirely inside of it in one go, so counting points in a dense cluster (or finding their centroid)
+ * doesn't have to look at the points at all.
+ * Both the box tests and the leaf scans compare squared distances against range^2 (2d leaves through
+ * the vectorized kernels in radiuskernels.h), so the results match a brute-force scan exactly.
+ *
+ * The tree works in any number of dimensions. Queries are templated on the dimension (see
+ * dimensions.h): the specialized versions must match the dimension the tree was built with, and
+ * D == 0 works for any.
+ *
+ * The tree keeps its own copy of the coordinates, reordered so that every subtree is one contiguous
+ * run of each column. Queries report the indices the points had in the columns the tree was built from.
+ */
+class KdTree
+{
+public:
+    KdTree() { m_dimension = 0; }
+
+    void build(const double* const* columns, int dimension, int count);
+
+    template <int D>
+    int countWithinRadius(const double* point, double range) const;
+    template <int D>
+    bool anyWithinRadius(const double* point, double range) const;
+    template <int D>
+    int sumWithinRadius(const double* point, double range, double* sums) const;
+    template <int D>
+    void query(const double* point, double range, std::vector<int>& out) const;
+    template <int D>
+    int nearest(const double* point) const;
+
+    int size() const { return (int)m_index.size(); }
+    int dimension() const { return m_dimension; }
+
+private:
+    static const int LEAF_SIZE = 16;    //two AVX-512 or four AVX2 compares per leaf
+    static const int MAX_DEPTH = 128;
+
+    struct Node {
+        int begin, end;     //range of the point columns covered by this subtree
+        int left, right;    //child node indices, -1 for leaves
+    };
+
+    int m_dimension;
+    std::vector<double> m_coordinates;  //one column per dimension, each size() long
+    std::vector<double> m_bounds;       //per node: the lower corner of its box, then the upper corner
+    std::vector<double> m_sums;         //per node: the coordinates of its points, summed per dimension
+    std::vector<int> m_index;           //original index of each point
+    std::vector<Node> m_nodes;
+
+    const double* column(int d) const { return &m_coordinates[(size_t)d * m_index.size()]; }
+    const double* lowerCorner(int node) const { return &m_bounds[(size_t)node * 2 * m_dimension]; }
+    const double* upperCorner(int node) const { return lowerCorner(node) + m_dimension; }
+    const double* nodeSums(int node) const { return &m_sums[(size_t)node * m_dimension]; }
+
+    template <int D>
+    double minDistanceSquared(int node, const double* point) const;
+    template <int D>
+    double maxDistanceSquared(int node, const double* point) const;
+    template <int D>
+    int leafCollect(const Node& node, const double* point, double range, int* hits) const;
+
+    int buildNode(int begin, int end, std::vector<int>& order, const double* const* columns);
+};
+
+#endif // KDTREE_H
@@ -0,0 +1,241 @@
+#include "kmeans.h"
+#include "parallel.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <stdio.h>
+
+KMeans::KMeans(int clusters, int iterations, QObject *parent)
+    : Clusterer(parent)
+{
+    m_k = clusters;
+    m_iterations = std::max(1, iterations);
+    m_inertia = 0;
+}
+
+/**
+ * @brief KMeans::clusterData Runs k-means, specialized for the dimension of the data if possible.
+ */
+void KMeans::clusterData() {
+    switch (m_data.dimension()) {
+#define RUN_DIMENSION(D) case D: run<D>(); break;
+    SPECIALIZED_DIMENSIONS(RUN_DIMENSION)
+#undef RUN_DIMENSION
+    default:
+        run<0>();
+        break;
+    }
+}
+
+/**
+ * @brief KMeans::run Seeds the centroids, runs Lloyd's iterations until no point changes cluster, and
+ * turns the final assignment into clusters.
+ */
+template <int D>
+void KMeans::run() {
+    const int k = std::min(m_k, m_data.size());
+    printf("Running k-means with %i clusters on %i-dimensional data...\n", k, m_data.dimension());
+    if (k < 1)
+        return;
+
+    {
+        ScopedTimer timer(m_metrics, Metrics::Setup);
+        seedCentroids<D>(k);
+    }
+
+    {
+        ScopedTimer timer(m_metrics, Metrics::Convergence);
+        std::vector<double> sums;
+        std::vector<int> counts;
+        for (int i = 0; i < m_iterations; i++) {
+            QElapsedTimer iterationTimer;
+            if (m_metrics.isEnabled())
+                iterationTimer.start();
+
+            int changed = assignPoints<D>(k, sums, counts);
+            m_iterationsRun = i + 1;
+            if (m_metrics.isEnabled())
+                m_metrics.addIteration(iterationTimer.nsecsElapsed());
+            if (!m_headless)
+                printf("Finished iteration %i (%i points changed cluster)...\n", i, changed);
+            if (changed == 0)
+                break;
+        }
+    }
+
+    ScopedTimer timer(m_metrics, Metrics::Assignment);
+    buildClusters(k);
+    printf("k-means finished after %i iterations with %i clusters (inertia %g)\n", m_iterationsRun,
+           clusterCount(), m_inertia);
+}
+
+/**
+ * @brief KMeans::seedCentroids Picks the first k centroids with k-means++: the first is a random point,
+ * and every next one is a point picked with probability proportional to its squared distance from
+ * the closest centroid so far.
+ * @details The distances are updated a chunk at a time, and each chunk keeps its total, so a pick
+ * only scans the one chunk it lands in.
+ */
+template <int D>
+void KMeans::seedCentroids(int k) {
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    const int count = m_data.size();
+    const int chunks = (count + POINT_CHUNK_SIZE - 1) / POINT_CHUNK_SIZE;
+    m_centroids.resize((size_t)k * dimension);
+    std::vector<double> closest(count);     //squared distance to the closest centroid so far
+    std::vector<double> chunkTotals(chunks);
+    RandomStream random(m_seed, 0, 0, RandomSeeding);
+
+    int pick = std::min(count - 1, (int)random.uniform(0, count));
+    for (int c = 0; c < k; c++) {
+        double* centroid = &m_centroids[(size_t)c * dimension];
+        for (int d = 0; d < dimension; d++)
+            centroid[d] = m_data.columns[d][pick];
+        if (c + 1 == k)
+            break;
+
+        forEachChunk([&](int chunk, int begin, int end) {
+            double point[PointCapacity<D>::value];
+            double total = 0;
+            for (int i = begin; i < end; i++) {
+                for (int d = 0; d < dimension; d++)
+                    point[d] = m_data.columns[d][i];
+                double distanceSquared = pointDistanceSquared<D>(point, centroid, dimension);
+                if (c == 0 || distanceSquared < closest[i])
+                    closest[i] = distanceSquared;
+                total += closest[i];
+            }
+            chunkTotals[chunk] = total;
+        });
+
+        double total = 0;
+        for (int chunk = 0; chunk < chunks; chunk++)
+            total += chunkTotals[chunk];
+        double target = random.uniform(0, total);
+        int chunk = 0;
+        while (chunk < chunks - 1 && target >= chunkTotals[chunk]) {
+            target -= chunkTotals[chunk];
+            chunk++;
+        }
+        int end = std::min(count, (chunk + 1) * POINT_CHUNK_SIZE);
+        pick = end - 1;     //in case rounding leaves some of the target over
+        for (int i = chunk * POINT_CHUNK_SIZE; i < end; i++) {
+            target -= closest[i];
+            if (target < 0) {
+                pick = i;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief KMeans::assignPoints One Lloyd iteration: moves every point to the cluster of its closest
+ * centroid, then every centroid to the mean of its points. Centroids left without points stay put.
+ * @param sums Scratch space for the per-chunk coordinate sums, reused between iterations.
+ * @param counts Scratch space for the per-chunk point counts.
+ * @return The number of points that changed cluster.
+ */
+template <int D>
+int KMeans::assignPoints(int k, std::vector<double> &sums, std::vector<int> &counts) {
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    const int chunks = (m_data.size() + POINT_CHUNK_SIZE - 1) / POINT_CHUNK_SIZE;
+    const size_t chunkSize = (size_t)k * dimension;
+    sums.assign(chunkSize * chunks, 0.0);
+    counts.assign((size_t)k * chunks, 0);
+    std::vector<int> changed(chunks, 0);
+    std::vector<double> inertia(chunks, 0.0);
+
+    forEachChunk([&](int chunk, int begin, int end) {
+        double* chunkSums = &sums[chunkSize * chunk];
+        int* chunkCounts = &counts[(size_t)k * chunk];
+        double point[PointCapacity<D>::value];
+        for (int i = begin; i < end; i++) {
+            for (int d = 0; d < dimension; d++)
+                point[d] = m_data.columns[d][i];
+            double distanceSquared;
+            int nearest = nearestCentroid<D>(point, k, distanceSquared);
+            if (nearest != m_data.group[i]) {
+                m_data.group[i] = nearest;
+                changed[chunk]++;
+            }
+            inertia[chunk] += distanceSquared;
+            chunkCounts[nearest]++;
+            double* centroidSums = chunkSums + (size_t)nearest * dimension;
+            for (int d = 0; d < dimension; d++)
+                centroidSums[d] += point[d];
+        }
+    });
+
+    //Add the chunks up in order, so the sums don't depend on which thread finished first
+    int totalChanged = changed[0];
+    m_inertia = inertia[0];
+    for (int chunk = 1; chunk < chunks; chunk++) {
+        totalChanged += changed[chunk];
+        m_inertia += inertia[chunk];
+        for (size_t j = 0; j < chunkSize; j++)
+            sums[j] += sums[chunkSize * chunk + j];
+        for (int c = 0; c < k; c++)
+            counts[c] += counts[(size_t)k * chunk + c];
+    }
+
+    for (int c = 0; c < k; c++) {
+        if (counts[c] == 0)
+            continue;
+        for (int d = 0; d < dimension; d++)
+            m_centroids[(size_t)c * dimension + d] = sums[(size_t)c * dimension + d] / counts[c];
+    }
+    return totalChanged;
+}
+
+/**
+ * @brief KMeans::nearestCentroid Finds the centroid closest to a point; ties go to the lowest index.
+ * @param distanceSquared Receives the squared distance to it.
+ */
+template <int D>
+int KMeans::nearestCentroid(const double *point, int k, double &distanceSquared) const {
+    const int dimension = dimensionCount<D>(m_data.dimension());
+    int nearest = 0;
+    distanceSquared = pointDistanceSquared<D>(point, &m_centroids[0], dimension);
+    for (int c = 1; c < k; c++) {
+        double candidate = pointDistanceSquared<D>(point, &m_centroids[(size_t)c * dimension], dimension);
+        if (candidate < distanceSquared) {
+            distanceSquared = candidate;
+            nearest = c;
+        }
+    }
+    return nearest;
+}
+
+/**
+ * @brief KMeans::buildClusters Turns the centroid every point was assigned to into clusters,
+ * numbered in order of their lowest point. Centroids without points don't get one.
+ */
+void KMeans::buildClusters(int k) {
+    std::vector<int> centroidCluster(k, -1);
+    for (int i = 0; i < m_data.size(); i++) {
+        int centroid = m_data.group[i];
+        if (centroidCluster[centroid] == -1)
+            centroidCluster[centroid] = createCluster()->id;
+        m_data.group[i] = centroidCluster[centroid];
+        m_clusters[m_data.group[i]]->points.push_back(i);
+    }
+}
+
+/**
+ * @brief KMeans::forEachChunk Calls body(chunk, begin, end) for every chunk of POINT_CHUNK_SIZE points.
+ * Runs on the thread pool in parallel mode; the chunks are the same either way.
+ */
+template <typename Function>
+void KMeans::forEachChunk(Function body) {
+    if (!m_parallel) {
+        std::vector<IndexRange> chunks = chunkRanges(m_data.size(), POINT_CHUNK_SIZE);
+        for (unsigned int c = 0; c < chunks.size(); c++)
+            body(c, chunks[c].begin, chunks[c].end);
+        return;
+    }
+    parallelFor(m_data.size(), POINT_CHUNK_SIZE, [&body](int begin, int end) {
+        body(begin / POINT_CHUNK_SIZE, begin, end);
+    });
+}
@@ -0,0 +1,50 @@
+#ifndef KMEANS_H
+#define KMEANS_H
+
+#include "clusterer.h"
+
+#include <vector>
+
+/**
+ * @brief The KMeans class Lloyd's k-means, as a baseline to time AgentCluster against on the same
+ * data and hardware.
+ * @details The centroids are seeded with k-means++, then every iteration assigns each point to its
+ * closest centroid and moves the centroids to the mean of their points, until no point changes
+ * cluster or the iteration limit is reached.
+ *
+ * In parallel mode the points are spread over the thread pool in fixed chunks. Every chunk sums its
+ * own points, and the chunks are added up in order, so the result doesn't depend on the number of
+ * threads. Like AgentCluster, the distance code is specialized for the dimension of the data.
+ *
+ * In the metrics, setup is the seeding, convergence the Lloyd iterations (each one timed) and
+ * assignment building the clusters.
+ */
+class KMeans : public Clusterer
+{
+    Q_OBJECT
+
+public:
+    KMeans(int clusters, int iterations, QObject *parent = 0);
+
+    double inertia() const { return m_inertia; }
+
+protected:
+    void clusterData();
+
+private:
+    int m_k;
+    int m_iterations;
+    std::vector<double> m_centroids;    //m_k rows of dimension() coordinates
+    double m_inertia;                   //sum of squared distances from the points to their centroids
+
+    template <int D> void run();
+    template <int D> void seedCentroids(int k);
+    template <int D> int assignPoints(int k, std::vector<double>& sums, std::vector<int>& counts);
+    template <int D> int nearestCentroid(const double* point, int k, double& distanceSquared) const;
+    void buildClusters(int k);
+
+    template <typename Function>
+    void forEachChunk(Function body);
+};
+
+#endif // KMEANS_H
@@ -1,30 +1,50 @@
 #include <QApplication>
 #include <QThread>
+#include <QStringList>
+#include <QElapsedTimer>
 
 #include "agentcluster.h"
+#include "kmeans.h"
+#include "dbscan.h"
 #include "clustercanvas.h"
 #include "faso.h"
 #include "def.h"
+#include "csvloader.h"
+#include "binarydataset.h"
 
 #include <time.h>
 #include <stdio.h>
 
 void printUsage();
+int convertDataset(const QStringList& args);
+int runHeadless(const QStringList& args, int iterations, int instances, int swarmSize, double distanceError,
+                int dimension, const ConvergenceCriteria& convergence, unsigned long long seed,
+                const std::string& metricsFile);
+int dimensionOption(const QStringList& args);
+Clusterer* createClusterer(const QStringList& args, int iterations, int swarmSize, double distanceError,
+                           const ConvergenceCriteria& convergence);
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
-    std::srand(time(NULL));
-
-    QStringList args = a.arguments();
+    //Arguments are read before the QApplication exists, since headless runs never create one.
+    QStringList args;
+    for (int i = 0; i < argc; i++)
+        args << QString::fromLocal8Bit(argv[i]);
     if (args.size() < 2) {
         printUsage();
         return 0;
     }
 
+    if (args.contains("--convert"))
+        return convertDataset(args);
+
     int iterations = 100;
     int instances = 1;
     int swarmSize = -1;
+    double distanceError = AVG_DIST_SAMPLE_ERROR;
+    int dimension = dimensionOption(args);
+    ConvergenceCriteria convergence;
+    unsigned long long seed = (unsigned long long)time(NULL);
 
     if (args.contains("-n")) {
         int iterationsIndex =args.indexOf("-n") + 1;
@@ -54,31 +74,99 @@ int main(int argc, char *argv[])
         instances = args.at(instanceIndex).toInt();
         printf("User set instance count: %i\n", instances);
     }
+    if (args.contains("-e")) {
+        int errorIndex = args.indexOf("-e") + 1;
+        if (errorIndex >= args.size()) {
+            printf("Error: distance error not specified\n\n");
+            return 1;
+        }
+        distanceError = args.at(errorIndex).toDouble();
+        printf("User set average distance error: %f\n", distanceError);
+    }
+    if (args.contains("-k")) {
+        int patienceIndex = args.indexOf("-k") + 1;
+        if (patienceIndex >= args.size()) {
+            printf("Error: convergence patience not specified\n\n");
+            return 1;
+        }
+        convergence.patience = args.at(patienceIndex).toInt();
+        printf("User set convergence patience: %i\n", convergence.patience);
+    }
+    if (args.contains("--tolerance")) {
+        int toleranceIndex = args.indexOf("--tolerance") + 1;
+        if (toleranceIndex >= args.size()) {
+            printf("Error: convergence tolerance not specified\n\n");
+            return 1;
+        }
+        convergence.tolerance = args.at(toleranceIndex).toDouble();
+        printf("User set convergence tolerance: %f\n", convergence.tolerance);
+    }
+    if (args.contains("--seed")) {
+        int seedIndex = args.indexOf("--seed") + 1;
+        if (seedIndex >= args.size()) {
+            printf("Error: seed not specified\n\n");
+            return 1;
+        }
+        seed = args.at(seedIndex).toULongLong();
+    }
+    printf("Using seed: %llu\n", seed);
+    std::string metricsFile;
+    if (args.contains("--metrics")) {
+        int metricsIndex = args.indexOf("--metrics") + 1;
+        if (metricsIndex >= args.size()) {
+            printf("Error: metrics file not specified\n\n");
+            return 1;
+        }
+        metricsFile = args.at(metricsIndex).toStdString();
+        if (!args.contains("-c"))
+            printf("Warning: metrics are only recorded in clustering mode\n");
+    }
+
+    if (args.contains("--headless"))
+        return runHeadless(args, iterations, instances, swarmSize, distanceError, dimension, convergence, seed,
+                           metricsFile);
 
+    QApplication a(argc, argv);
+    qRegisterMetaType<Dataset*>("Dataset*");
+    qRegisterMetaType<std::vector<Cluster*>*>("std::vector<Cluster*>*");
     ClusterCanvas* canvas = new ClusterCanvas();
     QThread *workThread = new QThread();
 
     if (args.contains("-c")) {  //we're using it to cluster...
         std::string dataFile = args.last().toStdString();
-        AgentCluster *cluster = new AgentCluster(iterations, swarmSize, 0);
+        Clusterer *cluster = createClusterer(args, iterations, swarmSize, distanceError, convergence);
+        if (!cluster)
+            return 1;
+        cluster->setParallel(args.contains("-p"));
+        cluster->setSeed(seed);
+        cluster->setDimension(dimension);
+        if (!metricsFile.empty())
+            cluster->setMetricsFile(metricsFile);
         cluster->moveToThread(workThread);
         QObject::connect(workThread, SIGNAL(started()), cluster, SLOT(start()));
-        QObject::connect(cluster, SIGNAL(update(std::vector<ClusterItem*>*,std::vector<Agent*>*)), canvas, SLOT(updateDisplay(std::vector<ClusterItem*>*,std::vector<Agent*>*)));
-        QObject::connect(cluster, SIGNAL(setClusters(std::vector<Cluster*>*)), canvas, SLOT(setClusters(std::vector<Cluster*>*)));
+        AgentCluster* agentCluster = qobject_cast<AgentCluster*>(cluster);
+        if (agentCluster) {     //the baselines have no swarm to show
+            canvas->watch(agentCluster->snapshots(), agentCluster->data());
+            QObject::connect(cluster, SIGNAL(snapshotReady()), canvas, SLOT(showLatestSnapshot()));
+        }
+        QObject::connect(cluster, SIGNAL(setClusters(std::vector<Cluster*>*,Dataset*)), canvas, SLOT(setClusters(std::vector<Cluster*>*,Dataset*)));
         if (!cluster->loadData(dataFile)) {
-            printf("Error: unable to open data file: %s\n\n", dataFile.c_str());
+            printf("Error: unable to load data file: %s\n\n", dataFile.c_str());
             return -1;
         } else
-            printf("...loaded data: %i points\n", (int)cluster->dataCount());
+            printf("...loaded data: %i points in %i dimensions\n", cluster->dataCount(), cluster->dimension());
 
         workThread->start();
     } else {    //otherwise, use a generic optimization function.
         TestFunction type = Ackley;
         FASO* faso = new FASO(iterations, instances, swarmSize, type);
+        faso->setSeed(seed);
+        faso->setConvergence(convergence);
         canvas->setFunction(type);
         faso->moveToThread(workThread);
         QObject::connect(workThread, SIGNAL(started()), faso, SLOT(start()));
-        QObject::connect(faso, SIGNAL(update(std::vector<Agent*>*)), canvas, SLOT(updateDisplay(std::vector<Agent*>*)));
+        canvas->watch(faso->snapshots());
+        QObject::connect(faso, SIGNAL(snapshotReady()), canvas, SLOT(showLatestSnapshot()));
         workThread->start();
     }
 
@@ -86,18 +174,178 @@ int main(int argc, char *argv[])
 }
 
 
+/**
+ * @brief runHeadless Runs the selected algorithm straight on the main thread, without a QApplication,
+ * canvas or worker thread. Nothing is connected to the solver's signals, and the solver is told not to
+ * emit per-iteration updates or pause between iterations, so the reported time is only computation.
+ * @return Process exit code.
+ */
+int runHeadless(const QStringList& args, int iterations, int instances, int swarmSize, double distanceError,
+                int dimension, const ConvergenceCriteria& convergence, unsigned long long seed,
+                const std::string& metricsFile) {
+    QElapsedTimer timer;
+    int iterationsRun = 0;
+    if (args.contains("-c")) {
+        std::string dataFile = args.last().toStdString();
+        Clusterer* cluster = createClusterer(args, iterations, swarmSize, distanceError, convergence);
+        if (!cluster)
+            return 1;
+        cluster->setParallel(args.contains("-p"));
+        cluster->setHeadless(true);
+        cluster->setSeed(seed);
+        cluster->setDimension(dimension);
+        if (!metricsFile.empty())
+            cluster->setMetricsFile(metricsFile);
+        if (!cluster->loadData(dataFile)) {
+            printf("Error: unable to load data file: %s\n\n", dataFile.c_str());
+            delete cluster;
+            return -1;
+        }
+        printf("...loaded data: %i points in %i dimensions\n", cluster->dataCount(), cluster->dimension());
+
+        timer.start();
+        cluster->start();
+        iterationsRun = cluster->iterationsRun();
+        delete cluster;
+    } else {
+        FASO faso(iterations, instances, swarmSize, Ackley);
+        faso.setHeadless(true);
+        faso.setSeed(seed);
+        faso.setConvergence(convergence);
+
+        timer.start();
+        faso.start();
+        iterationsRun = faso.iterationsRun();
+    }
+    printf("Finished %i of at most %i iterations in %.3f s\n", iterationsRun, iterations, timer.nsecsElapsed() / 1e9);
+    return 0;
+}
+
+
+/**
+ * @brief createClusterer Creates the clustering algorithm picked with --algorithm: fasc (AgentCluster,
+ * the default), or one of the baselines, kmeans (--clusters k) or dbscan (--eps, --min-points).
+ * @return The algorithm, or 0 if the options are invalid.
+ */
+Clusterer* createClusterer(const QStringList& args, int iterations, int swarmSize, double distanceError,
+                           const ConvergenceCriteria& convergence) {
+    QString algorithm = "fasc";
+    int algorithmIndex = args.indexOf("--algorithm") + 1;
+    if (algorithmIndex > 0 && algorithmIndex < args.size())
+        algorithm = args.at(algorithmIndex);
+
+    if (algorithm == "kmeans") {
+        int clusters = 8;
+        int clustersIndex = args.indexOf("--clusters") + 1;
+        if (clustersIndex > 0 && clustersIndex < args.size())
+            clusters = args.at(clustersIndex).toInt();
+        if (clusters < 1) {
+            printf("Error: k-means needs at least one cluster\n\n");
+            return 0;
+        }
+        printf("Using k-means with %i clusters\n", clusters);
+        return new KMeans(clusters, iterations);
+    }
+
+    if (algorithm == "dbscan") {
+        int epsIndex = args.indexOf("--eps") + 1;
+        double eps = (epsIndex > 0 && epsIndex < args.size()) ? args.at(epsIndex).toDouble() : 0;
+        if (eps <= 0) {
+            printf("Error: DBSCAN needs a positive --eps\n\n");
+            return 0;
+        }
+        int minPoints = 5;
+        int minPointsIndex = args.indexOf("--min-points") + 1;
+        if (minPointsIndex > 0 && minPointsIndex < args.size())
+            minPoints = args.at(minPointsIndex).toInt();
+        printf("Using DBSCAN with eps %f and %i min points\n", eps, minPoints);
+        return new Dbscan(eps, minPoints);
+    }
+
+    if (algorithm != "fasc") {
+        printf("Error: unknown algorithm: %s\n\n", algorithm.toLocal8Bit().constData());
+        return 0;
+    }
+    AgentCluster* cluster = new AgentCluster(iterations, swarmSize);
+    cluster->setExactDistance(args.contains("-x"));
+    cluster->setDistanceError(distanceError);
+    cluster->setConvergence(convergence);
+    return cluster;
+}
+
+
+/**
+ * @brief convertDataset Converts a CSV file to the binary dataset format:
+ * --convert <data.csv> <data.fasc>
+ * @return Process exit code.
+ */
+int convertDataset(const QStringList& args) {
+    int inputIndex = args.indexOf("--convert") + 1;
+    if (inputIndex + 1 >= args.size()) {
+        printf("Error: --convert needs an input and an output file\n\n");
+        return 1;
+    }
+    std::string input = args.at(inputIndex).toStdString();
+    std::string output = args.at(inputIndex + 1).toStdString();
+
+    Dataset data;
+    CsvLoadStats stats;
+    if (!CsvLoader::load(input, data, &stats, dimensionOption(args)))
+        return 1;
+    if (!BinaryDataset::save(output, data)) {
+        printf("Error: unable to write binary dataset: %s\n\n", output.c_str());
+        return 1;
+    }
+    printf("Converted %i %i-dimensional points (%i rows skipped) from %s to %s\n", data.size(), data.dimension(),
+           stats.skippedRows, input.c_str(), output.c_str());
+    return 0;
+}
+
+
+/**
+ * @brief dimensionOption Reads the -d option: how many leading columns of the data make up a point.
+ * @return The dimension, or 0 to use every leading numeric column.
+ */
+int dimensionOption(const QStringList& args) {
+    int dimensionIndex = args.indexOf("-d") + 1;
+    if (dimensionIndex <= 0 || dimensionIndex >= args.size())
+        return 0;
+    int dimension = args.at(dimensionIndex).toInt();
+    if (dimension < 2 || dimension > MAX_DIMENSIONS) {
+        printf("Warning: ignoring dimension %i, which isn't between 2 and %i\n", dimension, MAX_DIMENSIONS);
+        return 0;
+    }
+    printf("User set dimension: %i\n", dimension);
+    return dimension;
+}
+
+
 /**
  * @brief printUsage Prints program usage to stdout
  */
 void printUsage() {
     printf("Usage: AgentCluster [options] <data.csv>\n");
-    printf("\nWhere <data.csv> is a comma-separated list of input data, with two ");
-    printf("columns, each representing an x/y position. The values will be graphically ");
-    printf("clustered using the AgentCluster algorithm.\n\n");
+    printf("\nWhere <data.csv> is a comma-separated list of input data, with one row per ");
+    printf("point and one column per dimension (at least two; the first two are drawn as x/y). ");
+    printf("The values will be graphically clustered using the AgentCluster algorithm.\n\n");
     printf("Options:\n");
     printf("\t-c\tUse clustering (FASC) mode. By default, uses generic FASO mode\n");
-    printf("\t-n\tNumber of iterations to run\n");
+    printf("\t-n\tMaximum number of iterations to run\n");
     printf("\t-s\tNumber of agents in swarm\n");
-    printf("\t-i\tNumber of swarm instances whose results should be averaged together");
+    printf("\t-i\tNumber of swarm instances whose results should be averaged together\n");
+    printf("\t-e\tRelative error allowed when estimating the average point distance\n");
+    printf("\t-d\tNumber of leading columns that make up a point. By default, every leading numeric column\n");
+    printf("\t-x\tCompute the exact average point distance instead of estimating it\n");
+    printf("\t-p\tMove all agents at once on every core (synchronous updates, clustering mode)\n");
+    printf("\t-k\tLength of the windows compared to detect convergence, in iterations (0: never stop early)\n");
+    printf("\t--tolerance\tConverged once the mean outcome of the last two windows differs by less than this fraction\n");
+    printf("\t--headless\tRun without a display, signals or animation delays, and report the run time\n");
+    printf("\t--algorithm\tClustering algorithm: fasc (default), or the kmeans and dbscan baselines\n");
+    printf("\t--clusters\tNumber of clusters for kmeans (default 8)\n");
+    printf("\t--eps\tNeighborhood radius for dbscan\n");
+    printf("\t--min-points\tPoints within --eps (itself included) that make a dbscan core point (default 5)\n");
+    printf("\t--metrics <out.json>\tWrite phase and iteration timings and query counts to a JSON file (clustering mode)\n");
+    printf("\t--seed\tSeed for the random number streams. Runs with the same seed and options are identical\n");
+    printf("\t--convert <data.csv> <data.fasc>\tConvert a CSV file to a binary dataset, which loads without parsing");
     printf("\n\n\n");
 }
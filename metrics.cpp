@@ -0,0 +1,71 @@
+#include "metrics.h"
+
+#include <stdio.h>
+
+Metrics::Metrics() {
+    m_enabled = false;
+    reset();
+}
+
+/**
+ * @brief Metrics::reset Zeroes the timers from first on, every counter and the iteration times.
+ * @details Timers before first keep their time, so loading the data can be timed before a run that
+ * resets everything after it.
+ */
+void Metrics::reset(Timer first) {
+    for (int t = first; t < TimerCount; t++) {
+        m_nanoseconds[t] = 0;
+        m_calls[t] = 0;
+    }
+    for (int c = 0; c < CounterCount; c++)
+        m_counters[c].store(0, std::memory_order_relaxed);
+    m_iterations.clear();
+}
+
+void Metrics::addTime(Timer timer, qint64 nanoseconds) {
+    m_nanoseconds[timer] += nanoseconds;
+    m_calls[timer]++;
+}
+
+void Metrics::addIteration(qint64 nanoseconds) {
+    if (m_enabled)
+        m_iterations.push_back(nanoseconds / 1e9);
+}
+
+/**
+ * @brief Metrics::writeJson Writes every timer (milliseconds and calls), counter and iteration time.
+ * @param path File to (over)write.
+ * @return False if the file couldn't be written.
+ */
+bool Metrics::writeJson(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "{\n  \"timers\": {");
+    for (int t = 0; t < TimerCount; t++) {
+        fprintf(file, "%s\n    \"%s\": { \"ms\": %.3f, \"calls\": %lld }", t ? "," : "", name((Timer)t),
+                m_nanoseconds[t] / 1e6, m_calls[t]);
+    }
+    fprintf(file, "\n  },\n  \"counters\": {");
+    for (int c = 0; c < CounterCount; c++)
+        fprintf(file, "%s\n    \"%s\": %lld", c ? "," : "", name((Counter)c), counter((Counter)c));
+    fprintf(file, "\n  },\n  \"iterations_ms\": [");
+    for (unsigned int i = 0; i < m_iterations.size(); i++)
+        fprintf(file, "%s%.3f", i ? ", " : "", m_iterations[i] * 1e3);
+    fprintf(file, "]\n}\n");
+
+    bool written = !ferror(file);
+    return (fclose(file) == 0) && written;
+}
+
+const char* Metrics::name(Timer timer) {
+    static const char* names[TimerCount] = { "load", "setup", "convergence", "update", "moves",
+                                             "consolidation", "assignment" };
+    return names[timer];
+}
+
+const char* Metrics::name(Counter counter) {
+    static const char* names[CounterCount] = { "neighbor_queries", "points_found" };
+    return names[counter];
+}
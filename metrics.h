@@ -0,0 +1,98 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The Metrics class Where the time goes in a run: total time and call counts of the main
+ * steps, the time of every iteration, and how many neighbor queries were made.
+ * @details Everything is off by default. While disabled, timers don't read the clock and counters
+ * don't touch memory, so the instrumentation costs one predictable branch per call.
+ *
+ * Timers are meant for the controlling thread, around whole steps. Counters may be bumped from any
+ * thread; they are relaxed atomics, so add a batch at a time rather than one per point.
+ */
+class Metrics
+{
+public:
+    enum Timer {
+        Load,
+        Setup,
+        Convergence,
+        Update,         //happiness and ranges, once per iteration
+        Moves,          //the move loop, once per iteration
+        Consolidation,
+        Assignment,
+        TimerCount
+    };
+    enum Counter {
+        NeighborQueries,    //radius and nearest queries against the data tree, agent grid or agent tree
+        PointsFound,        //points those queries found (or counted) in range
+        CounterCount
+    };
+
+    Metrics();
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+    void reset(Timer first = Load);
+
+    void addTime(Timer timer, qint64 nanoseconds);
+    void addIteration(qint64 nanoseconds);
+    void count(Counter counter, long long amount = 1) {
+        if (m_enabled)
+            m_counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    double seconds(Timer timer) const { return m_nanoseconds[timer] / 1e9; }
+    long long calls(Timer timer) const { return m_calls[timer]; }
+    long long counter(Counter counter) const { return m_counters[counter].load(std::memory_order_relaxed); }
+    const std::vector<double>& iterationSeconds() const { return m_iterations; }
+
+    bool writeJson(const std::string& path) const;
+
+    static const char* name(Timer timer);
+    static const char* name(Counter counter);
+
+private:
+    bool m_enabled;
+    long long m_nanoseconds[TimerCount];
+    long long m_calls[TimerCount];
+    std::atomic<long long> m_counters[CounterCount];
+    std::vector<double> m_iterations;   //seconds per convergence iteration
+
+    Metrics(const Metrics&);
+    Metrics& operator=(const Metrics&);
+};
+
+/**
+ * @brief The ScopedTimer class Adds the time until it goes out of scope to one of the timers of a
+ * Metrics, if the metrics are enabled.
+ */
+class ScopedTimer
+{
+public:
+    ScopedTimer(Metrics& metrics, Metrics::Timer timer)
+        : m_metrics(metrics.isEnabled() ? &metrics : 0), m_timer(timer) {
+        if (m_metrics)
+            m_clock.start();
+    }
+    ~ScopedTimer() {
+        if (m_metrics)
+            m_metrics->addTime(m_timer, m_clock.nsecsElapsed());
+    }
+
+private:
+    Metrics* m_metrics;     //0 while disabled
+    Metrics::Timer m_timer;
+    QElapsedTimer m_clock;
+
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+};
+
+#endif // METRICS_H
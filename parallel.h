@@ -0,0 +1,51 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QtConcurrent>
+#include <vector>
+#include <algorithm>
+
+/**
+ * @brief The IndexRange struct A half-open [begin, end) range of loop indices handed to one task.
+ */
+struct IndexRange {
+    int begin;
+    int end;
+};
+
+/**
+ * @brief chunkRanges Splits [0, count) into consecutive ranges of at most chunkSize indices.
+ * @details The split only depends on count and chunkSize, never on the number of threads, so
+ * per-chunk results that are combined in chunk order come out the same on every machine.
+ */
+inline std::vector<IndexRange> chunkRanges(int count, int chunkSize) {
+    std::vector<IndexRange> chunks;
+    if (chunkSize < 1)
+        chunkSize = 1;
+    for (int begin = 0; begin < count; begin += chunkSize) {
+        IndexRange range;
+        range.begin = begin;
+        range.end = std::min(count, begin + chunkSize);
+        chunks.push_back(range);
+    }
+    return chunks;
+}
+
+/**
+ * @brief parallelFor Runs body(begin, end) over [0, count) on the global QThreadPool, in chunks of
+ * chunkSize indices, and blocks until every chunk is done.
+ * @param count Number of loop indices.
+ * @param chunkSize Number of indices per task.
+ * @param body Callable taking (int begin, int end).
+ */
+template <typename Function>
+void parallelFor(int count, int chunkSize, Function body) {
+    std::vector<IndexRange> chunks = chunkRanges(count, chunkSize);
+    if (chunks.size() == 1) {   //not worth a trip through the thread pool
+        body(chunks[0].begin, chunks[0].end);
+        return;
+    }
+    QtConcurrent::blockingMap(chunks, [&body](IndexRange& range) { body(range.begin, range.end); });
+}
+
+#endif // PARALLEL_H
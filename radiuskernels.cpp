@@ -0,0 +1,390 @@
+#include "radiuskernels.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RADIUS_KERNELS_X86
+#include <immintrin.h>
+//the gather intrinsics start from an "undefined" register, which GCC reports as uninitialized
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+//SCALAR KERNELS
+static inline bool withinRange(double px, double py, double x, double y, double rangeSquared) {
+    double dx = px - x;
+    double dy = py - y;
+    return dx * dx + dy * dy <= rangeSquared;
+}
+
+static int scalarCount(const double* xs, const double* ys, int count,
+                       double x, double y, double range) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    int found = 0;
+    for (int i = 0; i < count; i++)
+        found += withinRange(xs[i], ys[i], x, y, r2);
+    return found;
+}
+static int scalarCollect(const double* xs, const double* ys, int count,
+                         double x, double y, double range, int* out) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        if (withinRange(xs[i], ys[i], x, y, r2))
+            out[found++] = i;
+    }
+    return found;
+}
+static int scalarCountIndexed(const double* xs, const double* ys, const int* indices, int count,
+                              double x, double y, double range, int exclude) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        int index = indices[i];
+        found += (index != exclude && withinRange(xs[index], ys[index], x, y, r2));
+    }
+    return found;
+}
+static int scalarCollectIndexed(const double* xs, const double* ys, const int* indices, int count,
+                                double x, double y, double range, int exclude, int* out) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        int index = indices[i];
+        if (index != exclude && withinRange(xs[index], ys[index], x, y, r2))
+            out[found++] = index;
+    }
+    return found;
+}
+
+static const RadiusKernels scalarKernels = {
+    "scalar", scalarCount, scalarCollect, scalarCountIndexed, scalarCollectIndexed
+};
+
+
+#ifdef RADIUS_KERNELS_X86
+
+/**
+ * @brief appendLanes Writes base + lane for every set bit of a comparison mask.
+ * @return The new number of entries in out.
+ */
+static inline int appendLanes(unsigned int mask, int base, int* out, int found) {
+    while (mask) {
+        out[found++] = base + __builtin_ctz(mask);
+        mask &= mask - 1;
+    }
+    return found;
+}
+
+/**
+ * @brief appendIndexedLanes Writes indices[base + lane] for every set bit of a comparison mask.
+ * @return The new number of entries in out.
+ */
+static inline int appendIndexedLanes(unsigned int mask, const int* indices, int base, int* out, int found) {
+    while (mask) {
+        out[found++] = indices[base + __builtin_ctz(mask)];
+        mask &= mask - 1;
+    }
+    return found;
+}
+
+
+//SSE2 KERNELS, 2 points per instruction. SSE2 has no gather, so the indexed variants load lanes one by one.
+//Nor does it imply POPCNT, and the library fallback for __builtin_popcount costs more than the compare.
+static inline int bitCount2(unsigned int mask) {
+    return (int)((mask & 1) + (mask >> 1));
+}
+
+KERNEL_TARGET("sse2") static inline unsigned int sse2Mask(__m128d px, __m128d py, __m128d vx, __m128d vy, __m128d vr) {
+    __m128d dx = _mm_sub_pd(px, vx);
+    __m128d dy = _mm_sub_pd(py, vy);
+    __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+    return (unsigned int)_mm_movemask_pd(_mm_cmple_pd(d2, vr));
+}
+KERNEL_TARGET("sse2") static inline unsigned int sse2IndexedMask(const double* xs, const double* ys, const int* indices,
+                                                                 int i, __m128d vx, __m128d vy, __m128d vr, int exclude) {
+    int a = indices[i];
+    int b = indices[i + 1];
+    unsigned int mask = sse2Mask(_mm_set_pd(xs[b], xs[a]), _mm_set_pd(ys[b], ys[a]), vx, vy, vr);
+    if (a == exclude)
+        mask &= ~1u;
+    if (b == exclude)
+        mask &= ~2u;
+    return mask;
+}
+
+KERNEL_TARGET("sse2") static int sse2Count(const double* xs, const double* ys, int count,
+                                           double x, double y, double range) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m128d vx = _mm_set1_pd(x), vy = _mm_set1_pd(y), vr = _mm_set1_pd(r2);
+    int found = 0;
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        found += bitCount2(sse2Mask(_mm_loadu_pd(xs + i), _mm_loadu_pd(ys + i), vx, vy, vr));
+    for (; i < count; i++)
+        found += withinRange(xs[i], ys[i], x, y, r2);
+    return found;
+}
+KERNEL_TARGET("sse2") static int sse2Collect(const double* xs, const double* ys, int count,
+                                             double x, double y, double range, int* out) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m128d vx = _mm_set1_pd(x), vy = _mm_set1_pd(y), vr = _mm_set1_pd(r2);
+    int found = 0;
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        found = appendLanes(sse2Mask(_mm_loadu_pd(xs + i), _mm_loadu_pd(ys + i), vx, vy, vr), i, out, found);
+    for (; i < count; i++) {
+        if (withinRange(xs[i], ys[i], x, y, r2))
+            out[found++] = i;
+    }
+    return found;
+}
+KERNEL_TARGET("sse2") static int sse2CountIndexed(const double* xs, const double* ys, const int* indices, int count,
+                                                  double x, double y, double range, int exclude) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m128d vx = _mm_set1_pd(x), vy = _mm_set1_pd(y), vr = _mm_set1_pd(r2);
+    int found = 0;
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        found += bitCount2(sse2IndexedMask(xs, ys, indices, i, vx, vy, vr, exclude));
+    if (i < count)
+        found += scalarCountIndexed(xs, ys, indices + i, count - i, x, y, range, exclude);
+    return found;
+}
+KERNEL_TARGET("sse2") static int sse2CollectIndexed(const double* xs, const double* ys, const int* indices, int count,
+                                                    double x, double y, double range, int exclude, int* out) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m128d vx = _mm_set1_pd(x), vy = _mm_set1_pd(y), vr = _mm_set1_pd(r2);
+    int found = 0;
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        found = appendIndexedLanes(sse2IndexedMask(xs, ys, indices, i, vx, vy, vr, exclude), indices, i, out, found);
+    if (i < count)
+        found += scalarCollectIndexed(xs, ys, indices + i, count - i, x, y, range, exclude, out + found);
+    return found;
+}
+
+static const RadiusKernels sse2Kernels = {
+    "sse2", sse2Count, sse2Collect, sse2CountIndexed, sse2CollectIndexed
+};
+
+
+//AVX2 KERNELS, 4 points per instruction, with hardware gathers for the indexed variants.
+KERNEL_TARGET("avx2,popcnt") static inline unsigned int avx2Mask(__m256d px, __m256d py, __m256d vx, __m256d vy, __m256d vr) {
+    __m256d dx = _mm256_sub_pd(px, vx);
+    __m256d dy = _mm256_sub_pd(py, vy);
+    __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+    return (unsigned int)_mm256_movemask_pd(_mm256_cmp_pd(d2, vr, _CMP_LE_OQ));
+}
+KERNEL_TARGET("avx2,popcnt") static inline unsigned int avx2IndexedMask(const double* xs, const double* ys, const int* indices,
+                                                                 int i, __m256d vx, __m256d vy, __m256d vr, __m128i vexclude) {
+    __m128i index = _mm_loadu_si128((const __m128i*)(indices + i));
+    unsigned int mask = avx2Mask(_mm256_i32gather_pd(xs, index, 8), _mm256_i32gather_pd(ys, index, 8), vx, vy, vr);
+    unsigned int excluded = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(index, vexclude)));
+    return mask & ~excluded;
+}
+
+KERNEL_TARGET("avx2,popcnt") static int avx2Count(const double* xs, const double* ys, int count,
+                                           double x, double y, double range) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m256d vx = _mm256_set1_pd(x), vy = _mm256_set1_pd(y), vr = _mm256_set1_pd(r2);
+    int found = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        found += __builtin_popcount(avx2Mask(_mm256_loadu_pd(xs + i), _mm256_loadu_pd(ys + i), vx, vy, vr));
+    for (; i < count; i++)
+        found += withinRange(xs[i], ys[i], x, y, r2);
+    return found;
+}
+KERNEL_TARGET("avx2,popcnt") static int avx2Collect(const double* xs, const double* ys, int count,
+                                             double x, double y, double range, int* out) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m256d vx = _mm256_set1_pd(x), vy = _mm256_set1_pd(y), vr = _mm256_set1_pd(r2);
+    int found = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        found = appendLanes(avx2Mask(_mm256_loadu_pd(xs + i), _mm256_loadu_pd(ys + i), vx, vy, vr), i, out, found);
+    for (; i < count; i++) {
+        if (withinRange(xs[i], ys[i], x, y, r2))
+            out[found++] = i;
+    }
+    return found;
+}
+KERNEL_TARGET("avx2,popcnt") static int avx2CountIndexed(const double* xs, const double* ys, const int* indices, int count,
+                                                  double x, double y, double range, int exclude) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m256d vx = _mm256_set1_pd(x), vy = _mm256_set1_pd(y), vr = _mm256_set1_pd(r2);
+    const __m128i vexclude = _mm_set1_epi32(exclude);
+    int found = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        found += __builtin_popcount(avx2IndexedMask(xs, ys, indices, i, vx, vy, vr, vexclude));
+    if (i < count)
+        found += scalarCountIndexed(xs, ys, indices + i, count - i, x, y, range, exclude);
+    return found;
+}
+KERNEL_TARGET("avx2,popcnt") static int avx2CollectIndexed(const double* xs, const double* ys, const int* indices, int count,
+                                                    double x, double y, double range, int exclude, int* out) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m256d vx = _mm256_set1_pd(x), vy = _mm256_set1_pd(y), vr = _mm256_set1_pd(r2);
+    const __m128i vexclude = _mm_set1_epi32(exclude);
+    int found = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        found = appendIndexedLanes(avx2IndexedMask(xs, ys, indices, i, vx, vy, vr, vexclude), indices, i, out, found);
+    if (i < count)
+        found += scalarCollectIndexed(xs, ys, indices + i, count - i, x, y, range, exclude, out + found);
+    return found;
+}
+
+static const RadiusKernels avx2Kernels = {
+    "avx2", avx2Count, avx2Collect, avx2CountIndexed, avx2CollectIndexed
+};
+
+
+//AVX-512 KERNELS, 8 points per instruction. Comparisons produce lane masks directly.
+KERNEL_TARGET("avx512f,popcnt") static inline unsigned int avx512Mask(__m512d px, __m512d py, __m512d vx, __m512d vy, __m512d vr) {
+    __m512d dx = _mm512_sub_pd(px, vx);
+    __m512d dy = _mm512_sub_pd(py, vy);
+    __m512d d2 = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+    return (unsigned int)_mm512_cmp_pd_mask(d2, vr, _CMP_LE_OQ);
+}
+KERNEL_TARGET("avx512f,popcnt") static inline unsigned int avx512IndexedMask(const double* xs, const double* ys, const int* indices,
+                                                                      int i, __m512d vx, __m512d vy, __m512d vr, __m512i vexclude) {
+    __m256i index = _mm256_loadu_si256((const __m256i*)(indices + i));
+    unsigned int mask = avx512Mask(_mm512_i32gather_pd(index, xs, 8), _mm512_i32gather_pd(index, ys, 8), vx, vy, vr);
+    unsigned int excluded = (unsigned int)_mm512_cmpeq_epi64_mask(_mm512_cvtepi32_epi64(index), vexclude);
+    return mask & ~excluded;
+}
+
+KERNEL_TARGET("avx512f,popcnt") static int avx512Count(const double* xs, const double* ys, int count,
+                                                double x, double y, double range) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m512d vx = _mm512_set1_pd(x), vy = _mm512_set1_pd(y), vr = _mm512_set1_pd(r2);
+    int found = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        found += __builtin_popcount(avx512Mask(_mm512_loadu_pd(xs + i), _mm512_loadu_pd(ys + i), vx, vy, vr));
+    for (; i < count; i++)
+        found += withinRange(xs[i], ys[i], x, y, r2);
+    return found;
+}
+KERNEL_TARGET("avx512f,popcnt") static int avx512Collect(const double* xs, const double* ys, int count,
+                                                  double x, double y, double range, int* out) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m512d vx = _mm512_set1_pd(x), vy = _mm512_set1_pd(y), vr = _mm512_set1_pd(r2);
+    int found = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        found = appendLanes(avx512Mask(_mm512_loadu_pd(xs + i), _mm512_loadu_pd(ys + i), vx, vy, vr), i, out, found);
+    for (; i < count; i++) {
+        if (withinRange(xs[i], ys[i], x, y, r2))
+            out[found++] = i;
+    }
+    return found;
+}
+KERNEL_TARGET("avx512f,popcnt") static int avx512CountIndexed(const double* xs, const double* ys, const int* indices, int count,
+                                                       double x, double y, double range, int exclude) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m512d vx = _mm512_set1_pd(x), vy = _mm512_set1_pd(y), vr = _mm512_set1_pd(r2);
+    const __m512i vexclude = _mm512_set1_epi64(exclude);
+    int found = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        found += __builtin_popcount(avx512IndexedMask(xs, ys, indices, i, vx, vy, vr, vexclude));
+    if (i < count)
+        found += scalarCountIndexed(xs, ys, indices + i, count - i, x, y, range, exclude);
+    return found;
+}
+KERNEL_TARGET("avx512f,popcnt") static int avx512CollectIndexed(const double* xs, const double* ys, const int* indices, int count,
+                                                         double x, double y, double range, int exclude, int* out) {
+    if (range < 0)
+        return 0;
+    const double r2 = range * range;
+    const __m512d vx = _mm512_set1_pd(x), vy = _mm512_set1_pd(y), vr = _mm512_set1_pd(r2);
+    const __m512i vexclude = _mm512_set1_epi64(exclude);
+    int found = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        found = appendIndexedLanes(avx512IndexedMask(xs, ys, indices, i, vx, vy, vr, vexclude), indices, i, out, found);
+    if (i < count)
+        found += scalarCollectIndexed(xs, ys, indices + i, count - i, x, y, range, exclude, out + found);
+    return found;
+}
+
+static const RadiusKernels avx512Kernels = {
+    "avx512", avx512Count, avx512Collect, avx512CountIndexed, avx512CollectIndexed
+};
+
+#endif // RADIUS_KERNELS_X86
+
+
+/**
+ * @brief radiusKernels Looks up the kernels for a specific instruction set.
+ * @param level Instruction set to use.
+ * @return The kernels, or 0 if this CPU (or this build) doesn't support the instruction set.
+ */
+const RadiusKernels* radiusKernels(SimdLevel level) {
+    switch (level) {
+    case SimdScalar:
+        return &scalarKernels;
+#ifdef RADIUS_KERNELS_X86
+    case SimdSSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2") ? &sse2Kernels : 0;
+    case SimdAVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") ? &avx2Kernels : 0;
+    case SimdAVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt") ? &avx512Kernels : 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+static const RadiusKernels* pickBestKernels() {
+    for (int level = SimdAVX512; level > SimdScalar; level--) {
+        if (const RadiusKernels* kernels = radiusKernels((SimdLevel)level))
+            return kernels;
+    }
+    return &scalarKernels;
+}
+
+/**
+ * @brief bestRadiusKernels The kernels for the widest instruction set this CPU supports. Picked once,
+ * on first use.
+ */
+const RadiusKernels& bestRadiusKernels() {
+    static const RadiusKernels* best = pickBestKernels();
+    return *best;
+}
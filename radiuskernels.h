@@ -0,0 +1,56 @@
+#ifndef RADIUSKERNELS_H
+#define RADIUSKERNELS_H
+
+/**
+ * Vectorized fixed-radius kernels, shared by the spatial indices.
+ *
+ * Every kernel compares squared distances against range^2 for a run of points stored as separate
+ * x/y arrays, several points per instruction. The "indexed" variants read their points through an
+ * index list instead (gathering from the arrays), and can leave one index out of the results.
+ * Collecting kernels write a compressed list of hits and return how many there were: the plain
+ * variants write offsets into the run, the indexed ones write the indices themselves.
+ *
+ * The widest instruction set the CPU supports is picked the first time a kernel is used; builds for
+ * other architectures just get the scalar versions. A negative range never matches anything.
+ */
+
+enum SimdLevel {
+    SimdScalar,
+    SimdSSE2,
+    SimdAVX2,
+    SimdAVX512
+};
+
+struct RadiusKernels {
+    const char* name;
+    int (*count)(const double* xs, const double* ys, int count,
+                 double x, double y, double range);
+    int (*collect)(const double* xs, const double* ys, int count,
+                   double x, double y, double range, int* out);
+    int (*countIndexed)(const double* xs, const double* ys, const int* indices, int count,
+                        double x, double y, double range, int exclude);
+    int (*collectIndexed)(const double* xs, const double* ys, const int* indices, int count,
+                          double x, double y, double range, int exclude, int* out);
+};
+
+const RadiusKernels* radiusKernels(SimdLevel level);
+const RadiusKernels& bestRadiusKernels();
+
+inline int radiusCount(const double* xs, const double* ys, int count,
+                       double x, double y, double range) {
+    return bestRadiusKernels().count(xs, ys, count, x, y, range);
+}
+inline int radiusCollect(const double* xs, const double* ys, int count,
+                         double x, double y, double range, int* out) {
+    return bestRadiusKernels().collect(xs, ys, count, x, y, range, out);
+}
+inline int radiusCountIndexed(const double* xs, const double* ys, const int* indices, int count,
+                              double x, double y, double range, int exclude = -1) {
+    return bestRadiusKernels().countIndexed(xs, ys, indices, count, x, y, range, exclude);
+}
+inline int radiusCollectIndexed(const double* xs, const double* ys, const int* indices, int count,
+                                double x, double y, double range, int exclude, int* out) {
+    return bestRadiusKernels().collectIndexed(xs, ys, indices, count, x, y, range, exclude, out);
+}
+
+#endif // RADIUSKERNELS_H
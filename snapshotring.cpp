@@ -0,0 +1,45 @@
+#include "snapshotring.h"
+
+SnapshotRing::SnapshotRing() {
+    m_writing = 0;
+    m_shared.store(1, std::memory_order_relaxed);
+    m_reading = 2;
+}
+
+/**
+ * @brief SnapshotRing::publish Copies the swarm into the writer's slot and makes it the latest
+ * snapshot. Never waits for the reader. Writer only.
+ * @param agents The swarm to copy.
+ * @param iteration The iteration the swarm is at.
+ * @return True if the reader had already taken the previous snapshot, and so needs telling that
+ * there is a new one. False if an unread snapshot was replaced; the reader will find this one
+ * instead when it gets to it.
+ */
+bool SnapshotRing::publish(const Swarm &agents, int iteration) {
+    SwarmSnapshot& snapshot = m_slots[m_writing];
+    snapshot.iteration = iteration;
+    snapshot.x.assign(agents.x.begin(), agents.x.end());
+    snapshot.y.assign(agents.y.begin(), agents.y.end());
+    snapshot.foragingRange.assign(agents.foragingRange.begin(), agents.foragingRange.end());
+    snapshot.crowdingRange.assign(agents.crowdingRange.begin(), agents.crowdingRange.end());
+    snapshot.foragingRange.resize(snapshot.x.size(), 0.0);
+    snapshot.crowdingRange.resize(snapshot.x.size(), 0.0);
+
+    //Release makes the copy visible to the reader that acquires the slot
+    int previous = m_shared.exchange(m_writing | FRESH, std::memory_order_acq_rel);
+    m_writing = previous & INDEX_MASK;
+    return (previous & FRESH) == 0;
+}
+
+/**
+ * @brief SnapshotRing::acquire Takes the latest snapshot, if one was published since the last call.
+ * Never waits for the writer. Reader only.
+ * @return The snapshot, valid until the next acquire(), or 0 if there is nothing new.
+ */
+const SwarmSnapshot* SnapshotRing::acquire() {
+    if ((m_shared.load(std::memory_order_relaxed) & FRESH) == 0)
+        return 0;
+    int previous = m_shared.exchange(m_reading, std::memory_order_acq_rel);
+    m_reading = previous & INDEX_MASK;
+    return &m_slots[m_reading];
+}
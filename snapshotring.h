@@ -0,0 +1,62 @@
+#ifndef SNAPSHOTRING_H
+#define SNAPSHOTRING_H
+
+#include "def.h"
+
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief The SwarmSnapshot struct What the canvas needs to draw a swarm: a copy of the agents'
+ * positions in the first two dimensions and their ranges, as of one iteration.
+ */
+struct SwarmSnapshot {
+    int iteration;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> foragingRange;
+    std::vector<double> crowdingRange;
+
+    SwarmSnapshot() {
+        iteration = -1;
+    }
+
+    int size() const { return (int)x.size(); }
+};
+
+/**
+ * @brief The SnapshotRing class Hands swarm snapshots from a solver thread to the display without
+ * either side ever waiting for the other.
+ * @details A ring of three slots: the solver owns one to fill, the reader owns one to draw from, and
+ * the third holds the latest published snapshot. Publishing and acquiring each swap the owned slot
+ * with the shared one in a single atomic exchange, so neither blocks, and the slots are reused
+ * forever, so nothing is allocated once the vectors have grown to the swarm size. A snapshot that is
+ * published before the reader picked up the previous one replaces it: the reader always gets the
+ * newest snapshot, and stale ones are dropped.
+ *
+ * One writer and one reader at a time.
+ */
+class SnapshotRing
+{
+public:
+    static const int SLOTS = 3;
+
+    SnapshotRing();
+
+    bool publish(const Swarm& agents, int iteration);
+    const SwarmSnapshot* acquire();
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4;     //set on the shared slot until the reader has taken it
+
+    SwarmSnapshot m_slots[SLOTS];
+    std::atomic<int> m_shared;  //index of the shared slot, plus FRESH
+    int m_writing;              //owned by the writer
+    int m_reading;              //owned by the reader
+
+    SnapshotRing(const SnapshotRing&);
+    SnapshotRing& operator=(const SnapshotRing&);
+};
+
+#endif // SNAPSHOTRING_H
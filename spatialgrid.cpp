@@ -0,0 +1,257 @@
+#include "spatialgrid.h"
+#include "radiuskernels.h"
+
+#include <cmath>
+#include <algorithm>
+
+SpatialGrid::SpatialGrid() {
+    m_xs = m_ys = 0;
+    m_minX = m_minY = 0;
+    m_cellSize = 1.0;
+    m_columns = m_rows = 0;
+}
+
+/**
+ * @brief SpatialGrid::build Rebuilds the grid from scratch over 2d points.
+ * @param xs X positions of the points to index.
+ * @param ys Y positions of the points to index.
+ * @param count Number of points.
+ * @param cellSize Desired side length of a cell. Ideally the largest radius that will be queried.
+ * @param minX Left edge of the covered area.
+ * @param minY Bottom edge of the covered area.
+ * @param maxX Right edge of the covered area.
+ * @param maxY Top edge of the covered area.
+ */
+void SpatialGrid::build(const double *xs, const double *ys, int count,
+                        double cellSize, double minX, double minY, double maxX, double maxY) {
+    const double* columns[2] = { xs, ys };
+    build(columns, 2, count, cellSize, minX, minY, maxX, maxY);
+}
+
+/**
+ * @brief SpatialGrid::build Rebuilds the grid from scratch.
+ * @param columns Positions of the points to index, one array per dimension (at least two).
+ * @param dimension Number of dimensions.
+ * @param count Number of points.
+ * @param cellSize Desired side length of a cell. Ideally the largest radius that will be queried.
+ * @param minX Left edge of the covered area.
+ * @param minY Bottom edge of the covered area.
+ * @param maxX Right edge of the covered area.
+ * @param maxY Top edge of the covered area.
+ */
+void SpatialGrid::build(const double * const *columns, int dimension, int count,
+                        double cellSize, double minX, double minY, double maxX, double maxY) {
+    double width = maxX - minX;
+    double height = maxY - minY;
+
+    if (!(cellSize > 0))
+        cellSize = std::max(std::max(width, height), 1.0);
+    //Don't let a tiny cell size explode the cell count; coarser cells only cost pruning.
+    if (width / cellSize > MAX_CELLS_PER_AXIS)
+        cellSize = width / MAX_CELLS_PER_AXIS;
+    if (height / cellSize > MAX_CELLS_PER_AXIS)
+        cellSize = height / MAX_CELLS_PER_AXIS;
+
+    m_points.assign(columns, columns + dimension);
+    m_xs = columns[0];
+    m_ys = columns[1];
+    m_minX = minX;
+    m_minY = minY;
+    m_cellSize = cellSize;
+    m_columns = (int)(width / cellSize) + 1;
+    m_rows = (int)(height / cellSize) + 1;
+
+    m_cells.clear();
+    m_cells.resize(m_columns * m_rows);
+    for (int i = 0; i < count; i++)
+        insert(i);
+}
+
+/**
+ * @brief SpatialGrid::insert Adds a single point to the grid, based on its current position.
+ * @param index Index of the point in the arrays the grid was built over.
+ */
+void SpatialGrid::insert(int index) {
+    m_cells[cellIndex(m_xs[index], m_ys[index])].push_back(index);
+}
+
+/**
+ * @brief SpatialGrid::relocate Moves a point that has changed position into its new cell. Cheap when
+ * the point stayed inside its old cell, which is the common case for small steps.
+ * @param index Index of the point that moved. The arrays must already hold its new position.
+ * @param oldX X position the point was indexed at.
+ * @param oldY Y position the point was indexed at.
+ */
+void SpatialGrid::relocate(int index, double oldX, double oldY) {
+    int oldCell = cellIndex(oldX, oldY);
+    int newCell = cellIndex(m_xs[index], m_ys[index]);
+    if (oldCell == newCell)
+        return;
+
+    std::vector<int>& cell = m_cells[oldCell];
+    for (unsigned int i = 0; i < cell.size(); i++) {
+        if (cell[i] == index) {
+            cell[i] = cell.back();
+            cell.pop_back();
+            break;
+        }
+    }
+    m_cells[newCell].push_back(index);
+}
+
+/**
+ * @brief SpatialGrid::query Finds all points within range of a position.
+ * @param x X position to search around.
+ * @param y Y position to search around.
+ * @param range Search radius (inclusive).
+ * @param out Vector that the indices of matching points are appended to.
+ * @param exclude Index to leave out of the results (usually the one searching), or -1.
+ */
+void SpatialGrid::query(double x, double y, double range, std::vector<int> &out, int exclude) const {
+    int firstColumn, lastColumn, firstRow, lastRow;
+    if (!cellSpan(x, y, range, firstColumn, lastColumn, firstRow, lastRow))
+        return;
+
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            const std::vector<int>& cell = m_cells[row * m_columns + column];
+            if (cell.empty())
+                continue;
+            //grow for the worst case, let the kernel write the hits in place, then trim
+            unsigned int start = out.size();
+            out.resize(start + cell.size());
+            int found = radiusCollectIndexed(m_xs, m_ys, cell.data(), (int)cell.size(),
+                                             x, y, range, exclude, out.data() + start);
+            out.resize(start + found);
+        }
+    }
+}
+
+/**
+ * @brief SpatialGrid::count Counts the points within range of a position, without collecting them.
+ * @param x X position to search around.
+ * @param y Y position to search around.
+ * @param range Search radius (inclusive).
+ * @param exclude Index to leave out of the count, or -1.
+ * @return Number of points in range.
+ */
+int SpatialGrid::count(double x, double y, double range, int exclude) const {
+    int firstColumn, lastColumn, firstRow, lastRow;
+    if (!cellSpan(x, y, range, firstColumn, lastColumn, firstRow, lastRow))
+        return 0;
+
+    int found = 0;
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            const std::vector<int>& cell = m_cells[row * m_columns + column];
+            found += radiusCountIndexed(m_xs, m_ys, cell.data(), (int)cell.size(), x, y, range, exclude);
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief SpatialGrid::query Finds all points within range of a position, in D dimensions.
+ * @param point Position to search around, one coordinate per dimension.
+ * @param range Search radius (inclusive).
+ * @param out Vector that the indices of matching points are appended to.
+ * @param exclude Index to leave out of the results (usually the one searching), or -1.
+ */
+template <int D>
+void SpatialGrid::query(const double* point, double range, std::vector<int> &out, int exclude) const {
+    if (D == 2) {
+        query(point[0], point[1], range, out, exclude);
+        return;
+    }
+    int firstColumn, lastColumn, firstRow, lastRow;
+    if (!cellSpan(point[0], point[1], range, firstColumn, lastColumn, firstRow, lastRow))
+        return;
+
+    const double rangeSquared = range * range;
+    const double* const* columns = m_points.data();
+    const int dimension = (int)m_points.size();
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            const std::vector<int>& cell = m_cells[row * m_columns + column];
+            for (unsigned int i = 0; i < cell.size(); i++) {
+                int index = cell[i];
+                if (index != exclude && columnDistanceSquared<D>(point, columns, index, dimension) <= rangeSquared)
+                    out.push_back(index);
+            }
+        }
+    }
+}
+
+/**
+ * @brief SpatialGrid::count Counts the points within range of a position in D dimensions, without
+ * collecting them.
+ * @param point Position to search around, one coordinate per dimension.
+ * @param range Search radius (inclusive).
+ * @param exclude Index to leave out of the count, or -1.
+ * @return Number of points in range.
+ */
+template <int D>
+int SpatialGrid::count(const double* point, double range, int exclude) const {
+    if (D == 2)
+        return count(point[0], point[1], range, exclude);
+    int firstColumn, lastColumn, firstRow, lastRow;
+    if (!cellSpan(point[0], point[1], range, firstColumn, lastColumn, firstRow, lastRow))
+        return 0;
+
+    const double rangeSquared = range * range;
+    const double* const* columns = m_points.data();
+    const int dimension = (int)m_points.size();
+    int found = 0;
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            const std::vector<int>& cell = m_cells[row * m_columns + column];
+            for (unsigned int i = 0; i < cell.size(); i++) {
+                int index = cell[i];
+                if (index != exclude && columnDistanceSquared<D>(point, columns, index, dimension) <= rangeSquared)
+                    found++;
+            }
+        }
+    }
+    return found;
+}
+
+int SpatialGrid::column(double x) const {
+    double c = std::floor((x - m_minX) / m_cellSize);
+    if (!(c > 0))   //also catches NaN
+        return 0;
+    if (c >= m_columns)
+        return m_columns - 1;
+    return (int)c;
+}
+
+int SpatialGrid::row(double y) const {
+    double r = std::floor((y - m_minY) / m_cellSize);
+    if (!(r > 0))
+        return 0;
+    if (r >= m_rows)
+        return m_rows - 1;
+    return (int)r;
+}
+
+/**
+ * @brief SpatialGrid::cellSpan Finds the block of cells overlapping the bounding square of a search
+ * circle.
+ * @return False if the grid is empty or the range is negative.
+ */
+bool SpatialGrid::cellSpan(double x, double y, double range,
+                           int &firstColumn, int &lastColumn, int &firstRow, int &lastRow) const {
+    if (m_cells.empty() || range < 0)
+        return false;
+    firstColumn = column(x - range);
+    lastColumn = column(x + range);
+    firstRow = row(y - range);
+    lastRow = row(y + range);
+    return true;
+}
+
+#define INSTANTIATE_SPATIALGRID(D) \
+    template void SpatialGrid::query<D>(const double* point, double range, std::vector<int>& out, int exclude) const; \
+    template int SpatialGrid::count<D>(const double* point, double range, int exclude) const;
+SPECIALIZED_DIMENSIONS(INSTANTIATE_SPATIALGRID)
+INSTANTIATE_SPATIALGRID(0)
+#undef INSTANTIATE_SPATIALGRID
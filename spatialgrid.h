@@ -0,0 +1,119 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include "dimensions.h"
+#include "radiuskernels.h"
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * @brief The SpatialGrid class Bucketed uniform grid over a set of 2d points stored as separate x/y
+ * arrays (such as a Swarm), used to answer fixed-radius range queries without scanning every point.
+ * @details The grid covers the given bounding box with square cells holding point indices. Points
+ * outside of the box are clamped into the border cells, so queries stay correct for points that
+ * wander off the edge; they just stop being pruned as well. Queries only visit the cells overlapping
+ * the square around the search circle, then test the cell contents with the vectorized kernels from
+ * radiuskernels.h.
+ *
+ * Points with more than two dimensions can be indexed too, by building over one array per dimension.
+ * The cells still only split the first two, and the templated queries (see dimensions.h) check the
+ * full distance in every dimension.
+ *
+ * The grid reads positions straight from the arrays it was built over, so those arrays must stay
+ * alive (and not reallocate) until the next build.
+ */
+class SpatialGrid
+{
+public:
+    SpatialGrid();
+
+    void build(const double* xs, const double* ys, int count,
+               double cellSize, double minX, double minY, double maxX, double maxY);
+    void build(const double* const* columns, int dimension, int count,
+               double cellSize, double minX, double minY, double maxX, double maxY);
+    void insert(int index);
+    void relocate(int index, double oldX, double oldY);
+
+    void query(double x, double y, double range, std::vector<int>& out, int exclude = -1) const;
+    int count(double x, double y, double range, int exclude = -1) const;
+
+    template <int D>
+    void query(const double* point, double range, std::vector<int>& out, int exclude = -1) const;
+    template <int D>
+    int count(const double* point, double range, int exclude = -1) const;
+    template <int D, typename Visitor>
+    void visit(const double* point, double range, int exclude, Visitor visitor) const;
+
+    bool isEmpty() const { return m_cells.empty(); }
+
+private:
+    static const int MAX_CELLS_PER_AXIS = 1024;
+    static const int VISIT_BLOCK = 64;  //cell entries filtered per kernel call in visit()
+
+    std::vector<std::vector<int> > m_cells;
+    std::vector<const double*> m_points;    //one array per dimension
+    const double* m_xs;
+    const double* m_ys;
+    double m_minX;
+    double m_minY;
+    double m_cellSize;
+    int m_columns;
+    int m_rows;
+
+    int column(double x) const;
+    int row(double y) const;
+    int cellIndex(double x, double y) const { return row(y) * m_columns + column(x); }
+    bool cellSpan(double x, double y, double range,
+                  int& firstColumn, int& lastColumn, int& firstRow, int& lastRow) const;
+};
+
+/**
+ * @brief SpatialGrid::visit Calls visitor(index, distanceSquared) for every point within range of a
+ * position, for callers that gather several statistics about a neighborhood in one pass.
+ * @details Points are visited in the same order query() reports them in: cell by cell, row by row,
+ * then in the order each cell holds them. In 2d the cells are filtered by the vectorized kernels, a
+ * block at a time into a stack buffer, and only the hits get their distance recomputed. The distances
+ * are computed the same way the kernels do, so the visited points are exactly the ones query() would
+ * find.
+ * @param point Position to search around, one coordinate per dimension.
+ * @param range Search radius (inclusive).
+ * @param exclude Index to leave out (usually the one searching), or -1.
+ * @param visitor Callable taking the index of a point and its squared distance.
+ */
+template <int D, typename Visitor>
+void SpatialGrid::visit(const double* point, double range, int exclude, Visitor visitor) const {
+    int firstColumn, lastColumn, firstRow, lastRow;
+    if (!cellSpan(point[0], point[1], range, firstColumn, lastColumn, firstRow, lastRow))
+        return;
+
+    const double rangeSquared = range * range;
+    const double* const* columns = m_points.data();
+    const int dimension = (int)m_points.size();
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            const std::vector<int>& cell = m_cells[row * m_columns + column];
+            if (D == 2) {
+                int hits[VISIT_BLOCK];
+                for (int begin = 0; begin < (int)cell.size(); begin += VISIT_BLOCK) {
+                    int size = std::min((int)cell.size() - begin, (int)VISIT_BLOCK);
+                    int found = radiusCollectIndexed(m_xs, m_ys, cell.data() + begin, size,
+                                                     point[0], point[1], range, exclude, hits);
+                    for (int i = 0; i < found; i++)
+                        visitor(hits[i], columnDistanceSquared<2>(point, columns, hits[i], 2));
+                }
+                continue;
+            }
+            for (unsigned int i = 0; i < cell.size(); i++) {
+                int index = cell[i];
+                if (index == exclude)
+                    continue;
+                double distanceSquared = columnDistanceSquared<D>(point, columns, index, dimension);
+                if (distanceSquared <= rangeSquared)
+                    visitor(index, distanceSquared);
+            }
+        }
+    }
+}
+
+#endif // SPATIALGRID_H
@@ -0,0 +1,50 @@
+#include "unionfind.h"
+
+#include <utility>
+
+/**
+ * @brief UnionFind::reset Puts every element back into a set of its own. Not thread safe.
+ * @param size Number of elements.
+ */
+void UnionFind::reset(int size) {
+    m_parent = std::vector<std::atomic<int> >(size);
+    for (int i = 0; i < size; i++)
+        m_parent[i].store(i, std::memory_order_relaxed);
+}
+
+/**
+ * @brief UnionFind::find Finds the root of an element's set, which is the smallest element in it.
+ * @details Points every visited element at its grandparent on the way up (path halving). A failed
+ * shortcut just means another thread already moved that link closer to the root.
+ */
+int UnionFind::find(int element) {
+    while (true) {
+        int parent = m_parent[element].load(std::memory_order_acquire);
+        if (parent == element)
+            return element;
+        int grandparent = m_parent[parent].load(std::memory_order_acquire);
+        if (grandparent != parent)
+            m_parent[element].compare_exchange_weak(parent, grandparent, std::memory_order_release,
+                                                    std::memory_order_relaxed);
+        element = grandparent;
+    }
+}
+
+/**
+ * @brief UnionFind::unite Merges the sets holding two elements.
+ * @return True if they were in different sets.
+ */
+bool UnionFind::unite(int a, int b) {
+    while (true) {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return false;
+        if (a > b)
+            std::swap(a, b);
+        //b is a root that only the winner of this swap may re-link
+        int expected = b;
+        if (m_parent[b].compare_exchange_strong(expected, a, std::memory_order_acq_rel))
+            return true;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef UNIONFIND_H
+#define UNIONFIND_H
+
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief The UnionFind class Disjoint sets over [0, size), safe to merge from many threads at once
+ * without locks.
+ * @details Every set is a tree of parent links, and the root always has the smallest index in the
+ * set: unite() hangs the larger root under the smaller one with a compare-and-swap, and starts over
+ * if another thread got there first. find() halves the path as it goes. Links only ever point to a
+ * smaller index, so the trees can't loop, and since the root of a set doesn't depend on the order the
+ * merges happened in, the final sets (and their roots) are the same for any number of threads.
+ */
+class UnionFind
+{
+public:
+    UnionFind() {}
+    explicit UnionFind(int size) { reset(size); }
+
+    void reset(int size);
+    int find(int element);
+    bool unite(int a, int b);
+
+    int size() const { return (int)m_parent.size(); }
+
+private:
+    std::vector<std::atomic<int> > m_parent;
+};
+
+#endif // UNIONFIND_H